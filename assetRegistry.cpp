@@ -0,0 +1,78 @@
+#include "assetRegistry.h"
+
+unsigned int AssetRegistry::internPath(const std::string &path)
+{
+	std::unordered_map<std::string, unsigned int>::iterator found = pathIds.find(path);
+	if (found != pathIds.end())
+		return found->second;
+
+	unsigned int id = paths.size();
+	pathIds[path] = id;
+	paths.push_back(path);
+	pathSlots.push_back(-1);
+	return id;
+}
+
+AssetHandle AssetRegistry::acquire(const std::string &path)
+{
+	std::unordered_map<std::string, unsigned int>::iterator found = pathIds.find(path);
+	if (found == pathIds.end() || pathSlots[found->second] < 0)
+		return AssetHandle();
+
+	AssetSlot &slot = slots[pathSlots[found->second]];
+	slot.refCount++;
+	return AssetHandle(pathSlots[found->second], slot.generation);
+}
+
+AssetHandle AssetRegistry::add(const std::string &path)
+{
+	unsigned int pathId = internPath(path);
+
+	unsigned int index;
+	if (!freeSlots.empty())
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		index = slots.size();
+		AssetSlot fresh;
+		fresh.generation = 0;
+		slots.push_back(fresh);
+	}
+
+	AssetSlot &slot = slots[index];
+	slot.pathId = pathId;
+	slot.generation++;
+	//skip 0 if the counter ever wraps, it marks invalid handles
+	if (slot.generation == 0)
+		slot.generation = 1;
+	slot.refCount = 1;
+	pathSlots[pathId] = index;
+	liveCount++;
+	return AssetHandle(index, slot.generation);
+}
+
+void AssetRegistry::addRef(AssetHandle handle)
+{
+	if (isLive(handle))
+		slots[handle.index].refCount++;
+}
+
+bool AssetRegistry::release(AssetHandle handle)
+{
+	if (!isLive(handle))
+		return 0;
+
+	AssetSlot &slot = slots[handle.index];
+	slot.refCount--;
+	if (slot.refCount > 0)
+		return 0;
+
+	//the path can be loaded again into a new slot, old handles fail isLive from here on
+	pathSlots[slot.pathId] = -1;
+	freeSlots.push_back(handle.index);
+	liveCount--;
+	return 1;
+}
@@ -0,0 +1,91 @@
+#ifndef Z_ASSETS
+#define Z_ASSETS
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+//Reference to a loaded asset, stays safe to use after the asset is unloaded and its slot reused
+struct AssetHandle
+{
+	unsigned int index; //slot in the owning manager's lists
+	unsigned int generation; //bumped every time the slot is reused, 0 is never a live asset
+
+	AssetHandle()
+	{
+		index = 0;
+		generation = 0;
+	}
+	AssetHandle(unsigned int i, unsigned int gen)
+	{
+		index = i;
+		generation = gen;
+	}
+
+	//could this refer to an asset, says nothing about whether it's still loaded
+	bool isValid() const
+	{ return generation != 0; }
+	bool operator==(const AssetHandle &other) const
+	{ return index == other.index && generation == other.generation; }
+	bool operator!=(const AssetHandle &other) const
+	{ return !(*this == other); }
+};
+
+//Path to slot bookkeeping shared by the asset managers, the managers keep the actual data in lists indexed by slot
+class AssetRegistry
+{
+	//One loaded asset
+	struct AssetSlot
+	{
+		unsigned int pathId; //interned path it was loaded from
+		unsigned int generation; //generation of the handle currently given out
+		unsigned int refCount; //users left, the slot is free at 0
+	};
+
+	std::unordered_map<std::string, unsigned int> pathIds; //path to interned id
+	std::vector<std::string> paths; //interned id to path
+	std::vector<int> pathSlots; //interned id to the slot loaded from it, -1 if not loaded
+	std::vector<AssetSlot> slots;
+	std::vector<unsigned int> freeSlots; //released slots waiting to be reused
+	unsigned int liveCount; //slots in use
+public:
+	AssetRegistry()
+	{ liveCount = 0; }
+
+	//get the id of a path, the same path always gets the same id
+	unsigned int internPath(const std::string &path);
+	//get the path an id was interned from
+	const std::string& getPath(unsigned int pathId) const
+	{ return paths.at(pathId); }
+
+	//get the asset loaded from a path and add a reference to it, invalid handle if it isn't loaded
+	AssetHandle acquire(const std::string &path);
+	//give a newly loaded asset a slot with one reference, the slot may be one a released asset used
+	AssetHandle add(const std::string &path);
+	//add a reference to an asset
+	void addRef(AssetHandle handle);
+	//drop a reference, returns true when that was the last one and the asset should be freed
+	bool release(AssetHandle handle);
+
+	//is the handle for an asset that's still loaded
+	bool isLive(AssetHandle handle) const
+	{ return handle.index < slots.size() && handle.generation != 0 && slots[handle.index].generation == handle.generation && slots[handle.index].refCount > 0; }
+	//get the path of a loaded asset
+	const std::string& getPath(AssetHandle handle) const
+	{ return getSlotPath(handle.index); }
+	//get the path of the asset in a slot, still valid right after it's released
+	const std::string& getSlotPath(unsigned int index) const
+	{ return paths.at(slots.at(index).pathId); }
+	//get the references left on a loaded asset
+	unsigned int getRefCount(AssetHandle handle) const
+	{ return isLive(handle) ? slots[handle.index].refCount : 0; }
+
+	//number of slots ever handed out, the size the managers' lists need
+	unsigned int getSlotCount() const
+	{ return slots.size(); }
+	//number of loaded assets
+	unsigned int getLiveCount() const
+	{ return liveCount; }
+};
+
+#endif
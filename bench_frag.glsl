@@ -0,0 +1,13 @@
+#version 330 core
+
+// Ouput data
+layout(location = 0) out vec4 color;
+
+uniform sampler2DArray textureArray;
+uniform int layer;
+
+in vec2 UV;
+
+void main(){
+	color = texture(textureArray, vec3(UV, layer));
+}
\ No newline at end of file
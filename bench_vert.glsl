@@ -0,0 +1,15 @@
+#version 330 core
+
+// Input vertex data, different for all executions of this shader.
+layout(location = 0) in vec3 vertexPosition_modelspace;
+
+// Output data ; will be interpolated for each fragment.
+out vec2 UV;
+
+// How many times the texture repeats across the screen, higher is further away
+uniform float UVScale;
+
+void main(){
+	gl_Position =  vec4(vertexPosition_modelspace,1);
+	UV = (vertexPosition_modelspace.xy+vec2(1,1))/2.0 * UVScale;
+}
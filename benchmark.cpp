@@ -0,0 +1,227 @@
+#include <stdlib.h>
+
+#include "benchmark.h"
+#include "shader.h"
+
+//Counts every contact point a contact query finds
+struct ContactCounter : public btCollisionWorld::ContactResultCallback
+{
+	unsigned int contacts;
+
+	ContactCounter()
+	{ contacts = 0; }
+	btScalar addSingleResult(btManifoldPoint& cp, const btCollisionObjectWrapper* colObj0Wrap, int partId0, int index0, const btCollisionObjectWrapper* colObj1Wrap, int partId1, int index1)
+	{
+		contacts++;
+		return 0;
+	}
+};
+
+//random float between a and b
+static float randomBetween(float a, float b)
+{
+	return a + (b - a) * (rand() / (float)RAND_MAX);
+}
+
+//time the queries against one shape, the same pseudo random queries every call
+static void timeQueries(std::string label, btCollisionShape *shape, const ModelBounds &bounds, unsigned int queries)
+{
+	btDefaultCollisionConfiguration config;
+	btCollisionDispatcher dispatcher(&config);
+	btDbvtBroadphase broadphase;
+	btCollisionWorld world(&dispatcher, &broadphase, &config);
+
+	btCollisionObject meshObj;
+	meshObj.setCollisionShape(shape);
+	world.addCollisionObject(&meshObj);
+
+	//rays straight through the level from above to below, at random angles
+	srand(1234);
+	unsigned int hits = 0;
+	double start = glfwGetTime();
+	for (unsigned int i = 0; i < queries; i++)
+	{
+		btVector3 from(randomBetween(bounds.min.x, bounds.max.x), bounds.max.y + 1.0f, randomBetween(bounds.min.z, bounds.max.z));
+		btVector3 to(randomBetween(bounds.min.x, bounds.max.x), bounds.min.y - 1.0f, randomBetween(bounds.min.z, bounds.max.z));
+		btCollisionWorld::ClosestRayResultCallback result(from, to);
+		world.rayTest(from, to, result);
+		if (result.hasHit())
+			hits++;
+	}
+	double rayTime = glfwGetTime() - start;
+
+	//ball sized spheres at random points inside the bounds
+	btSphereShape sphere(1.0f);
+	btCollisionObject sphereObj;
+	sphereObj.setCollisionShape(&sphere);
+	ContactCounter counter;
+	start = glfwGetTime();
+	for (unsigned int i = 0; i < queries; i++)
+	{
+		btTransform trans;
+		trans.setIdentity();
+		trans.setOrigin(btVector3(randomBetween(bounds.min.x, bounds.max.x), randomBetween(bounds.min.y, bounds.max.y), randomBetween(bounds.min.z, bounds.max.z)));
+		sphereObj.setWorldTransform(trans);
+		world.contactTest(&sphereObj, counter);
+	}
+	double contactTime = glfwGetTime() - start;
+
+	world.removeCollisionObject(&meshObj);
+
+	std::cout << label << ": " << queries / rayTime << " rays/s (" << hits << " hits), "
+		<< queries / contactTime << " contact queries/s (" << counter.contacts << " contacts)" << std::endl;
+}
+
+void benchmarkCollision(std::string name, CollisionMesh *mesh, const ModelBounds &bounds, unsigned int queries)
+{
+	if (mesh == NULL)
+	{
+		reportError("No collision mesh to benchmark!(" + name + ")", 0);
+		return;
+	}
+	std::cout << "Collision benchmark for " << name << ", " << mesh->getTriangleCount() << " triangles, " << queries << " queries each" << std::endl;
+
+	double start = glfwGetTime();
+	btBvhTriangleMeshShape *fixedShape = new btBvhTriangleMeshShape(mesh->getVertexArray(), 1, btVector3(-1000, -1000, -1000), btVector3(1000, 1000, 1000));
+	double fixedBuild = glfwGetTime() - start;
+
+	start = glfwGetTime();
+	btBvhTriangleMeshShape *tightShape = new btBvhTriangleMeshShape(mesh->getVertexArray(), 1,
+		btVector3(bounds.min.x, bounds.min.y, bounds.min.z), btVector3(bounds.max.x, bounds.max.y, bounds.max.z));
+	double tightBuild = glfwGetTime() - start;
+
+	std::cout << "BVH build: " << fixedBuild * 1000.0 << " ms fixed box, " << tightBuild * 1000.0 << " ms tight bounds" << std::endl;
+	timeQueries("Fixed +-1000 box", fixedShape, bounds, queries);
+	timeQueries("Tight bounds", tightShape, bounds, queries);
+
+	delete fixedShape;
+	delete tightShape;
+}
+
+//GPU time of the passes at one tiling
+static double timeSampling(GLuint uvScaleID, GLuint query, float uvScale, unsigned int passes)
+{
+	glUniform1f(uvScaleID, uvScale);
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	for (unsigned int i = 0; i < passes; i++)
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	glEndQuery(GL_TIME_ELAPSED);
+
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+	return nanoseconds / 1e9;
+}
+
+void benchmarkTextureSampling(std::string name, GLuint texArray, GLuint layer, unsigned int passes)
+{
+	const int width = 1024;
+	const int height = 768;
+
+	//draw offscreen so nothing shows up in the window
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	GLuint colorbuffer;
+	glGenRenderbuffers(1, &colorbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorbuffer);
+	glViewport(0, 0, width, height);
+
+	static const GLfloat quad[] = {
+		-1.0f, -1.0f, 0.0f,
+		1.0f, -1.0f, 0.0f,
+		-1.0f, 1.0f, 0.0f,
+		-1.0f, 1.0f, 0.0f,
+		1.0f, -1.0f, 0.0f,
+		1.0f, 1.0f, 0.0f,
+	};
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	GLuint quadbuffer;
+	glGenBuffers(1, &quadbuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, quadbuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+	GLuint programID = LoadShaders("bench_vert.glsl", "bench_frag.glsl");
+	glUseProgram(programID);
+	GLuint uvScaleID = glGetUniformLocation(programID, "UVScale");
+	glUniform1i(glGetUniformLocation(programID, "textureArray"), 0);
+	glUniform1i(glGetUniformLocation(programID, "layer"), layer);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texArray);
+
+	GLuint query;
+	glGenQueries(1, &query);
+
+	std::cout << "Sampling benchmark for " << name << ", " << passes << " " << width << "x" << height << " passes each" << std::endl;
+	const float scales[] = { 1.0f, 4.0f, 16.0f, 64.0f };
+	double pixels = double(width) * height * passes;
+	for (unsigned int i = 0; i < sizeof(scales) / sizeof(scales[0]); i++)
+	{
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		double baseTime = timeSampling(uvScaleID, query, scales[i], passes);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		double mipTime = timeSampling(uvScaleID, query, scales[i], passes);
+
+		std::cout << "Tiled " << scales[i] << "x: " << pixels / baseTime / 1e6 << " Mpixels/s level 0 only, "
+			<< pixels / mipTime / 1e6 << " Mpixels/s mipmapped" << std::endl;
+	}
+
+	glDeleteQueries(1, &query);
+	glDeleteProgram(programID);
+	glDeleteBuffers(1, &quadbuffer);
+	glDeleteVertexArrays(1, &vao);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteRenderbuffers(1, &colorbuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+//time one frustum test both ways, the survivor counts have to match
+static void timeCulling(std::string label, const Frustum &frustum, const CullSpheres &spheres, unsigned int iterations)
+{
+	std::vector<unsigned int> survivors(spheres.count);
+	unsigned int simdCount = 0;
+	double start = glfwGetTime();
+	for (unsigned int i = 0; i < iterations; i++)
+		simdCount = cullSpheres(frustum, spheres, survivors.data());
+	double simdTime = glfwGetTime() - start;
+
+	unsigned int scalarCount = 0;
+	start = glfwGetTime();
+	for (unsigned int i = 0; i < iterations; i++)
+		scalarCount = cullSpheresScalar(frustum, spheres, survivors.data());
+	double scalarTime = glfwGetTime() - start;
+
+	if (simdCount != scalarCount)
+		reportError("Frustum culling results differ!(" + label + ")", 0);
+	std::cout << label << ": " << simdCount << " of " << spheres.count << " visible, "
+		<< simdTime / iterations * 1e6 << " us vectorized, " << scalarTime / iterations * 1e6 << " us scalar" << std::endl;
+}
+
+void benchmarkFrustumCulling(std::string name, const ModelBounds &bounds, unsigned int sphereCount, unsigned int iterations)
+{
+	//entity sized spheres spread over the level
+	srand(1234);
+	CullSpheres spheres;
+	spheres.resize(sphereCount);
+	for (unsigned int i = 0; i < sphereCount; i++)
+	{
+		glm::vec3 center(randomBetween(bounds.min.x, bounds.max.x), randomBetween(bounds.min.y, bounds.max.y), randomBetween(bounds.min.z, bounds.max.z));
+		spheres.set(i, center, randomBetween(0.5f, 2.0f));
+	}
+
+	//the views drawAll culls against, the camera looking across the level from one side
+	glm::vec3 middle = (bounds.min + bounds.max) * 0.5f;
+	glm::mat4 cameraView = glm::lookAt(glm::vec3(bounds.min.x, bounds.max.y, middle.z), middle, glm::vec3(0, 1, 0));
+	glm::mat4 cameraProj = glm::perspective(90.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.5f, 2, 2), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	glm::mat4 lightProj = glm::ortho<float>(-40, 40, -40, 40, -30, 50);
+
+	std::cout << "Culling benchmark for " << name << ", " << sphereCount << " spheres, " << iterations << " tests each" << std::endl;
+	timeCulling("Camera frustum", extractFrustum(cameraProj * cameraView), spheres, iterations);
+	timeCulling("Light frustum", extractFrustum(lightProj * lightView), spheres, iterations);
+}
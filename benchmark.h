@@ -0,0 +1,24 @@
+#ifndef Z_BENCH
+#define Z_BENCH
+
+#include <string>
+
+#include "modelManager.h"
+#include "frustum.h"
+
+//Uncomment to print the benchmarks once the level has loaded
+//#define RUN_BENCHMARKS
+
+//Time raycasts and sphere contact queries against a collision mesh, once with the BVH
+//quantized to the old fixed +-1000 box and once to the model's own bounds
+void benchmarkCollision(std::string name, CollisionMesh *mesh, const ModelBounds &bounds, unsigned int queries);
+
+//Time fullscreen passes sampling a texture tiled further and further away with GL timer queries,
+//once from level 0 only and once through its mips, the texture is a layer of an array like the texture manager makes
+void benchmarkTextureSampling(std::string name, GLuint texArray, GLuint layer, unsigned int passes);
+
+//Time frustum culling spheres scattered over a model's bounds against the camera's perspective frustum
+//and the light's ortho one, with the SSE2 test and one sphere at a time
+void benchmarkFrustumCulling(std::string name, const ModelBounds &bounds, unsigned int sphereCount, unsigned int iterations);
+
+#endif
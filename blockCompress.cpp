@@ -0,0 +1,555 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "blockCompress.h"
+
+#ifdef Z_SSE2
+#include <emmintrin.h>
+#endif
+
+//BC7 weights of the 16 palette entries between the two endpoints, out of 64
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//One block as floats, a channel at a time so 4 pixels fit a SIMD register
+struct BlockPixels
+{
+	float c[4][16]; //r, g, b, a
+};
+
+static void loadBlock(const unsigned char *block, BlockPixels &px)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			px.c[c][i] = block[i * 4 + c];
+	}
+}
+
+static float clampChannel(float v)
+{
+	return std::min(255.0f, std::max(0.0f, v));
+}
+
+//position of every pixel along e0 -> e1, rounded to 0..steps
+static void projectIndices(const BlockPixels &px, const float e0[4], const float e1[4], int channels, int steps, int indices[16])
+{
+	float dir[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float length2 = 0.0f;
+	for (int c = 0; c < channels; c++)
+	{
+		dir[c] = e1[c] - e0[c];
+		length2 += dir[c] * dir[c];
+	}
+	if (length2 < 1e-6f)
+	{
+		for (int i = 0; i < 16; i++)
+			indices[i] = 0;
+		return;
+	}
+	for (int c = 0; c < channels; c++)
+		dir[c] *= steps / length2;
+
+#ifdef Z_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 top = _mm_set1_ps((float)steps);
+	for (int i = 0; i < 16; i += 4)
+	{
+		__m128 t = half;
+		for (int c = 0; c < channels; c++)
+		{
+			__m128 offset = _mm_sub_ps(_mm_loadu_ps(&px.c[c][i]), _mm_set1_ps(e0[c]));
+			t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(dir[c])));
+		}
+		t = _mm_min_ps(_mm_max_ps(t, zero), top);
+		_mm_storeu_si128((__m128i*)&indices[i], _mm_cvttps_epi32(t));
+	}
+#else
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.5f;
+		for (int c = 0; c < channels; c++)
+			t += (px.c[c][i] - e0[c]) * dir[c];
+		indices[i] = (int)std::min((float)steps, std::max(0.0f, t));
+	}
+#endif
+}
+
+//corners of the bounding box, pulled in a little since the extremes are rarely worth hitting exactly
+static void boxEndpoints(const BlockPixels &px, int channels, float e0[4], float e1[4])
+{
+	for (int c = 0; c < channels; c++)
+	{
+		float lo = px.c[c][0];
+		float hi = px.c[c][0];
+		for (int i = 1; i < 16; i++)
+		{
+			lo = std::min(lo, px.c[c][i]);
+			hi = std::max(hi, px.c[c][i]);
+		}
+		float inset = (hi - lo) / 16.0f;
+		e0[c] = hi - inset;
+		e1[c] = lo + inset;
+	}
+}
+
+//ends of the block's colors along their principal axis
+static void principalEndpoints(const BlockPixels &px, int channels, float e0[4], float e1[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int c = 0; c < channels; c++)
+	{
+		for (int i = 0; i < 16; i++)
+			mean[c] += px.c[c][i];
+		mean[c] /= 16.0f;
+	}
+
+	float cov[4][4];
+	for (int a = 0; a < channels; a++)
+	{
+		for (int b = a; b < channels; b++)
+		{
+			float sum = 0.0f;
+			for (int i = 0; i < 16; i++)
+				sum += (px.c[a][i] - mean[a]) * (px.c[b][i] - mean[b]);
+			cov[a][b] = cov[b][a] = sum;
+		}
+	}
+
+	//power iteration, starting from the box diagonal converges in a few steps
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float lo[4], hi[4];
+	boxEndpoints(px, channels, hi, lo);
+	for (int c = 0; c < channels; c++)
+		axis[c] = hi[c] - lo[c];
+	for (int iter = 0; iter < 8; iter++)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length2 = 0.0f;
+		for (int a = 0; a < channels; a++)
+		{
+			for (int b = 0; b < channels; b++)
+				next[a] += cov[a][b] * axis[b];
+			length2 += next[a] * next[a];
+		}
+		if (length2 < 1e-12f)
+			break;
+		float inv = 1.0f / sqrtf(length2);
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] * inv;
+	}
+	float axisLength2 = 0.0f;
+	for (int c = 0; c < channels; c++)
+		axisLength2 += axis[c] * axis[c];
+	if (axisLength2 < 1e-12f)
+	{
+		//every pixel is the same color
+		for (int c = 0; c < channels; c++)
+			e0[c] = e1[c] = mean[c];
+		return;
+	}
+
+	float tMin = 0.0f;
+	float tMax = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++)
+			t += (px.c[c][i] - mean[c]) * axis[c];
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+	for (int c = 0; c < channels; c++)
+	{
+		e0[c] = clampChannel(mean[c] + axis[c] * tMax);
+		e1[c] = clampChannel(mean[c] + axis[c] * tMin);
+	}
+}
+
+//endpoints that best fit the pixels for fixed weights (0 is e0, 1 is e1), false if the weights don't pin them down
+static bool refineEndpoints(const BlockPixels &px, int channels, const float weights[16], float e0[4], float e1[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float b = weights[i];
+		float a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < channels; c++)
+		{
+			ax[c] += a * px.c[c][i];
+			bx[c] += b * px.c[c][i];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f)
+		return 0;
+	for (int c = 0; c < channels; c++)
+	{
+		e0[c] = clampChannel((bb * ax[c] - ab * bx[c]) / det);
+		e1[c] = clampChannel((aa * bx[c] - ab * ax[c]) / det);
+	}
+	return 1;
+}
+
+static unsigned short pack565(const float c[4])
+{
+	unsigned int r = (unsigned int)(c[0] * 31.0f / 255.0f + 0.5f);
+	unsigned int g = (unsigned int)(c[1] * 63.0f / 255.0f + 0.5f);
+	unsigned int b = (unsigned int)(c[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpack565(unsigned short v, float c[4])
+{
+	unsigned int r = (v >> 11) & 31;
+	unsigned int g = (v >> 5) & 63;
+	unsigned int b = v & 31;
+	c[0] = (float)((r << 3) | (r >> 2));
+	c[1] = (float)((g << 2) | (g >> 4));
+	c[2] = (float)((b << 3) | (b >> 2));
+	c[3] = 255.0f;
+}
+
+//write a 4 color BC1 block from two endpoints, returns its squared error and the weight each pixel got
+static float encodeColorBlock(const BlockPixels &px, const float e0[4], const float e1[4], unsigned char *out, float weights[16])
+{
+	unsigned short c0 = pack565(e0);
+	unsigned short c1 = pack565(e1);
+	//4 color mode needs c0 > c1
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	float q0[4], q1[4];
+	unpack565(c0, q0);
+	unpack565(c1, q1);
+	int indices[16];
+	if (c0 == c1)
+	{
+		for (int i = 0; i < 16; i++)
+			indices[i] = 0;
+	}
+	else
+		projectIndices(px, q0, q1, 3, 3, indices);
+
+	//steps along c0 -> c1 to BC1 palette order
+	static const unsigned int PALETTE_INDEX[4] = { 0, 2, 3, 1 };
+	unsigned int bits = 0;
+	float error = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		bits |= PALETTE_INDEX[indices[i]] << (2 * i);
+		weights[i] = indices[i] / 3.0f;
+		for (int c = 0; c < 3; c++)
+		{
+			//the hardware palette is what the pixel really becomes
+			float v = floorf((q0[c] * (3 - indices[i]) + q1[c] * indices[i]) / 3.0f);
+			error += (v - px.c[c][i]) * (v - px.c[c][i]);
+		}
+	}
+
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+	out[4] = bits & 0xff;
+	out[5] = (bits >> 8) & 0xff;
+	out[6] = (bits >> 16) & 0xff;
+	out[7] = bits >> 24;
+	return error;
+}
+
+static void encodeColor(const BlockPixels &px, EncodeQuality quality, unsigned char *out)
+{
+	float e0[4], e1[4];
+	if (quality == ENCODE_FAST)
+		boxEndpoints(px, 3, e0, e1);
+	else
+		principalEndpoints(px, 3, e0, e1);
+
+	float weights[16];
+	float error = encodeColorBlock(px, e0, e1, out, weights);
+	if (quality != ENCODE_HIGH)
+		return;
+
+	//refit the endpoints to the chosen weights, keep it only if the quantized result is better
+	unsigned char candidate[8];
+	for (int iter = 0; iter < 2 && error > 0.0f; iter++)
+	{
+		float r0[4], r1[4];
+		if (!refineEndpoints(px, 3, weights, r0, r1))
+			break;
+		float candidateWeights[16];
+		float candidateError = encodeColorBlock(px, r0, r1, candidate, candidateWeights);
+		if (candidateError >= error)
+			break;
+		error = candidateError;
+		memcpy(out, candidate, 8);
+		memcpy(weights, candidateWeights, sizeof(weights[0]) * 16);
+	}
+}
+
+//8 value alpha block between the block's smallest and largest alpha
+static void encodeAlpha(const BlockPixels &px, unsigned char *out)
+{
+	float lo = px.c[3][0];
+	float hi = px.c[3][0];
+	for (int i = 1; i < 16; i++)
+	{
+		lo = std::min(lo, px.c[3][i]);
+		hi = std::max(hi, px.c[3][i]);
+	}
+	unsigned char a0 = (unsigned char)hi;
+	unsigned char a1 = (unsigned char)lo;
+	memset(out, 0, 8);
+	out[0] = a0;
+	out[1] = a1;
+	if (a0 == a1)
+		return;
+
+	//steps along a0 -> a1 to palette order, a0 and a1 come first then the in betweens
+	unsigned long long bits = 0;
+	float scale = 7.0f / (a0 - a1);
+	for (int i = 0; i < 16; i++)
+	{
+		int step = (int)((a0 - px.c[3][i]) * scale + 0.5f);
+		step = std::min(7, std::max(0, step));
+		unsigned long long index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+		bits |= index << (3 * i);
+	}
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+void encodeBC1(const unsigned char *block, EncodeQuality quality, unsigned char *out)
+{
+	BlockPixels px;
+	loadBlock(block, px);
+	encodeColor(px, quality, out);
+}
+
+void encodeBC3(const unsigned char *block, EncodeQuality quality, unsigned char *out)
+{
+	BlockPixels px;
+	loadBlock(block, px);
+	encodeAlpha(px, out);
+	encodeColor(px, quality, out + 8);
+}
+
+//Writes fields into a block from the lowest bit up
+struct BitWriter
+{
+	unsigned char *out;
+	unsigned int pos;
+
+	BitWriter(unsigned char *block)
+	{
+		out = block;
+		pos = 0;
+	}
+	void write(unsigned int value, unsigned int bits)
+	{
+		for (unsigned int i = 0; i < bits; i++, pos++)
+			out[pos >> 3] |= ((value >> i) & 1) << (pos & 7);
+	}
+};
+
+//7 bit endpoint plus a p bit shared by its channels, picks the p bit that lands closest
+static void quantizeBC7Endpoint(const float e[4], int q[4], int &pBit)
+{
+	float bestError = 0.0f;
+	for (int p = 0; p < 2; p++)
+	{
+		int candidate[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; c++)
+		{
+			candidate[c] = std::min(127, std::max(0, (int)((e[c] - p) / 2.0f + 0.5f)));
+			float v = (float)(candidate[c] * 2 + p);
+			error += (v - e[c]) * (v - e[c]);
+		}
+		if (p == 0 || error < bestError)
+		{
+			bestError = error;
+			pBit = p;
+			for (int c = 0; c < 4; c++)
+				q[c] = candidate[c];
+		}
+	}
+}
+
+//BC7 mode 6 block from two endpoints, returns its squared error and the weight each pixel got
+static float encodeBC7Block(const BlockPixels &px, const float e0[4], const float e1[4], bool searchIndices, unsigned char *out, float weights[16])
+{
+	int q0[4], q1[4], p0, p1;
+	quantizeBC7Endpoint(e0, q0, p0);
+	quantizeBC7Endpoint(e1, q1, p1);
+	float d0[4], d1[4];
+	for (int c = 0; c < 4; c++)
+	{
+		d0[c] = (float)(q0[c] * 2 + p0);
+		d1[c] = (float)(q1[c] * 2 + p1);
+	}
+
+	int indices[16];
+	projectIndices(px, d0, d1, 4, 15, indices);
+
+	//the weights are only nearly even, check the neighbouring entries too
+	float error = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		int first = searchIndices ? std::max(0, indices[i] - 1) : indices[i];
+		int last = searchIndices ? std::min(15, indices[i] + 1) : indices[i];
+		float best = 0.0f;
+		for (int index = first; index <= last; index++)
+		{
+			float e = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				float v = (float)((((int)d0[c] * (64 - BC7_WEIGHTS[index]) + (int)d1[c] * BC7_WEIGHTS[index] + 32) >> 6));
+				e += (v - px.c[c][i]) * (v - px.c[c][i]);
+			}
+			if (index == first || e < best)
+			{
+				best = e;
+				indices[i] = index;
+			}
+		}
+		error += best;
+		weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+	}
+
+	//the first index has an implied 0 top bit, flip the endpoints if it would need a 1
+	if (indices[0] & 8)
+	{
+		std::swap(q0, q1);
+		std::swap(p0, p1);
+		for (int i = 0; i < 16; i++)
+		{
+			indices[i] = 15 - indices[i];
+			weights[i] = 1.0f - weights[i];
+		}
+	}
+
+	memset(out, 0, 16);
+	BitWriter bits(out);
+	bits.write(1 << 6, 7); //mode 6
+	for (int c = 0; c < 4; c++)
+	{
+		bits.write(q0[c], 7);
+		bits.write(q1[c], 7);
+	}
+	bits.write(p0, 1);
+	bits.write(p1, 1);
+	bits.write(indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		bits.write(indices[i], 4);
+	return error;
+}
+
+void encodeBC7(const unsigned char *block, EncodeQuality quality, unsigned char *out)
+{
+	BlockPixels px;
+	loadBlock(block, px);
+
+	float e0[4], e1[4];
+	if (quality == ENCODE_FAST)
+		boxEndpoints(px, 4, e0, e1);
+	else
+		principalEndpoints(px, 4, e0, e1);
+
+	float weights[16];
+	bool search = quality != ENCODE_FAST;
+	float error = encodeBC7Block(px, e0, e1, search, out, weights);
+	if (quality != ENCODE_HIGH)
+		return;
+
+	unsigned char candidate[16];
+	for (int iter = 0; iter < 2 && error > 0.0f; iter++)
+	{
+		float r0[4], r1[4];
+		if (!refineEndpoints(px, 4, weights, r0, r1))
+			break;
+		float candidateWeights[16];
+		float candidateError = encodeBC7Block(px, r0, r1, search, candidate, candidateWeights);
+		if (candidateError >= error)
+			break;
+		error = candidateError;
+		memcpy(out, candidate, 16);
+		memcpy(weights, candidateWeights, sizeof(weights[0]) * 16);
+	}
+}
+
+unsigned int getBlockBytes(TextureFormat format)
+{
+	switch (format)
+	{
+	case TEXTURE_BC1:
+		return 8;
+	case TEXTURE_BC3:
+	case TEXTURE_BC7:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+unsigned int getBlockRows(const MipLevel &level)
+{
+	return (level.height + 3) / 4;
+}
+
+void prepareCompressedChain(const MipChain &src, TextureFormat format, MipChain &dst)
+{
+	dst.format = format;
+	dst.levels = src.levels;
+	size_t total = 0;
+	for (unsigned int i = 0; i < dst.levels.size(); i++)
+	{
+		MipLevel &level = dst.levels[i];
+		level.offset = total;
+		level.size = (size_t)((level.width + 3) / 4) * getBlockRows(level) * getBlockBytes(format);
+		total += level.size;
+	}
+	dst.pixels.resize(total);
+}
+
+void compressBlockRows(const MipChain &src, unsigned int level, unsigned int firstRow, unsigned int rowCount, EncodeQuality quality, MipChain &dst)
+{
+	const MipLevel &srcLevel = src.levels[level];
+	const unsigned char *image = src.getLevel(level);
+	unsigned int blocksWide = (srcLevel.width + 3) / 4;
+	unsigned int blockBytes = getBlockBytes(dst.format);
+	unsigned char *out = &dst.pixels[dst.levels[level].offset];
+
+	unsigned char block[64];
+	for (unsigned int by = firstRow; by < firstRow + rowCount; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksWide; bx++)
+		{
+			//blocks hanging off the edge repeat the last row/column
+			for (int y = 0; y < 4; y++)
+			{
+				int sy = std::min((int)by * 4 + y, srcLevel.height - 1);
+				for (int x = 0; x < 4; x++)
+				{
+					int sx = std::min((int)bx * 4 + x, srcLevel.width - 1);
+					memcpy(&block[(y * 4 + x) * 4], image + ((size_t)sy * srcLevel.width + sx) * 4, 4);
+				}
+			}
+
+			unsigned char *blockOut = out + ((size_t)by * blocksWide + bx) * blockBytes;
+			if (dst.format == TEXTURE_BC1)
+				encodeBC1(block, quality, blockOut);
+			else if (dst.format == TEXTURE_BC3)
+				encodeBC3(block, quality, blockOut);
+			else if (dst.format == TEXTURE_BC7)
+				encodeBC7(block, quality, blockOut);
+		}
+	}
+}
@@ -0,0 +1,30 @@
+#ifndef Z_BLOCKCOMPRESS
+#define Z_BLOCKCOMPRESS
+
+#include "mipChain.h"
+
+//Speed/quality trade off of the block encoders
+enum EncodeQuality
+{
+	ENCODE_FAST, //bounding box endpoints
+	ENCODE_NORMAL, //endpoints along the principal axis of the block's colors
+	ENCODE_HIGH //principal axis, then least squares refinement of the endpoints
+};
+
+//Encode one 4x4 block of RGBA8 pixels, given row by row
+void encodeBC1(const unsigned char *block, EncodeQuality quality, unsigned char *out); //8 bytes out, alpha ignored
+void encodeBC3(const unsigned char *block, EncodeQuality quality, unsigned char *out); //16 bytes out
+void encodeBC7(const unsigned char *block, EncodeQuality quality, unsigned char *out); //16 bytes out, always mode 6
+
+//bytes in one 4x4 block, 4 for a pixel of RGBA8
+unsigned int getBlockBytes(TextureFormat format);
+//rows of 4x4 blocks in a level
+unsigned int getBlockRows(const MipLevel &level);
+
+//Size a chain to hold the compressed copy of an RGBA8 chain
+void prepareCompressedChain(const MipChain &src, TextureFormat format, MipChain &dst);
+//Compress some rows of blocks of one level into a chain from prepareCompressedChain
+//different rows or levels can be compressed on different threads at the same time
+void compressBlockRows(const MipChain &src, unsigned int level, unsigned int firstRow, unsigned int rowCount, EncodeQuality quality, MipChain &dst);
+
+#endif
@@ -0,0 +1,59 @@
+#include "bounds.h"
+
+ModelBounds computeBounds(const glm::vec3 *points, unsigned int count)
+{
+	ModelBounds bounds;
+	bounds.min = glm::vec3(0.0f);
+	bounds.max = glm::vec3(0.0f);
+	bounds.center = glm::vec3(0.0f);
+	bounds.radius = 0.0f;
+	if (count == 0)
+		return bounds;
+
+	bounds.min = points[0];
+	bounds.max = points[0];
+	for (unsigned int i = 1; i < count; i++)
+	{
+		bounds.min = glm::min(bounds.min, points[i]);
+		bounds.max = glm::max(bounds.max, points[i]);
+	}
+
+	//start from two far apart points, then grow to take in anything outside
+	glm::vec3 a = points[0];
+	glm::vec3 b = points[0];
+	float best = 0.0f;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float d = glm::dot(points[i] - a, points[i] - a);
+		if (d > best)
+		{
+			best = d;
+			b = points[i];
+		}
+	}
+	best = 0.0f;
+	glm::vec3 c = b;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float d = glm::dot(points[i] - b, points[i] - b);
+		if (d > best)
+		{
+			best = d;
+			c = points[i];
+		}
+	}
+
+	bounds.center = (b + c) * 0.5f;
+	bounds.radius = glm::length(c - b) * 0.5f;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float d = glm::length(points[i] - bounds.center);
+		if (d > bounds.radius)
+		{
+			float newRadius = (bounds.radius + d) * 0.5f;
+			bounds.center += (points[i] - bounds.center) * ((newRadius - bounds.radius) / d);
+			bounds.radius = newRadius;
+		}
+	}
+	return bounds;
+}
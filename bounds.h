@@ -0,0 +1,18 @@
+#ifndef Z_BOUNDS
+#define Z_BOUNDS
+
+#include <glm/glm.hpp>
+
+//Bounding volumes of a model in model space, for culling and broadphase use
+struct ModelBounds
+{
+	glm::vec3 min; //smallest corner of the AABB
+	glm::vec3 max; //largest corner of the AABB
+	glm::vec3 center; //center of the bounding sphere
+	float radius; //radius of the bounding sphere
+};
+
+//AABB and a near minimal bounding sphere (Ritter's) of a set of points
+ModelBounds computeBounds(const glm::vec3 *points, unsigned int count);
+
+#endif
@@ -0,0 +1,304 @@
+#include <fstream>
+#include <string.h>
+#include <unordered_map>
+
+#include <BulletCollision/CollisionDispatch/btInternalEdgeUtility.h>
+
+#include "collisionMesh.h"
+#include "error.h"
+
+const char BVH_CACHE_MAGIC[4] = { 'Z', 'B', 'V', 'H' };
+const unsigned int BVH_CACHE_VERSION = 1;
+
+//File layout: header, the in place serialized btOptimizedBvh, then the triangle infos, both 16 byte aligned
+struct BvhCacheHeader
+{
+	char magic[4];
+	unsigned int version;
+	unsigned long long contentHash;
+	unsigned int bvhOffset;
+	unsigned int bvhSize;
+	unsigned int infoOffset;
+	unsigned int infoCount;
+	float infoThresholds[6]; //convex, planar, equal vertex, edge distance, max edge angle, zero area
+	unsigned int fileSize;
+};
+
+//One entry of the triangle info map
+struct BvhCacheTriangleInfo
+{
+	int key; //part and triangle index
+	int flags;
+	float edgeAngles[3]; //v0v1, v1v2, v2v0
+};
+
+//round up to the section alignment
+static unsigned int alignSection(unsigned int offset)
+{
+	return (offset + 15) & ~15u;
+}
+
+//does count elements of size bytes starting at offset fit in the file, done in 64 bit so it can't wrap
+static bool inFile(unsigned int offset, unsigned long long count, unsigned long long size, unsigned int fileSize)
+{
+	return offset <= fileSize && count * size <= (unsigned long long)(fileSize - offset);
+}
+
+CollisionMesh::CollisionMesh(const glm::vec3 *verts, unsigned int vertCount, const unsigned int *inds, unsigned int indCount)
+{
+	vertices.assign(verts, verts + vertCount);
+
+	btIndexedMesh mesh;
+	mesh.m_numTriangles = indCount / 3;
+	mesh.m_numVertices = vertCount;
+	mesh.m_vertexBase = vertCount > 0 ? (const unsigned char*)&vertices[0] : NULL;
+	mesh.m_vertexStride = sizeof(glm::vec3);
+	mesh.m_vertexType = PHY_FLOAT;
+
+	//same rule as the render index buffers, 16 bit whenever the vertices allow it
+	if (vertCount <= 65536)
+	{
+		shortIndices.resize(indCount);
+		for (unsigned int i = 0; i < indCount; i++)
+			shortIndices[i] = (unsigned short)inds[i];
+		mesh.m_triangleIndexBase = indCount > 0 ? (const unsigned char*)&shortIndices[0] : NULL;
+		mesh.m_triangleIndexStride = 3 * sizeof(unsigned short);
+		mesh.m_indexType = PHY_SHORT;
+	}
+	else
+	{
+		intIndices.assign(inds, inds + indCount);
+		mesh.m_triangleIndexBase = indCount > 0 ? (const unsigned char*)&intIndices[0] : NULL;
+		mesh.m_triangleIndexStride = 3 * sizeof(unsigned int);
+		mesh.m_indexType = PHY_INTEGER;
+	}
+
+	vertexArray = new btTriangleIndexVertexArray;
+	vertexArray->addIndexedMesh(mesh, mesh.m_indexType);
+	infoMap = NULL;
+}
+
+unsigned long long CollisionMesh::hashContents() const
+{
+	unsigned long long hash = hashBytes(vertices.empty() ? NULL : &vertices[0], vertices.size() * sizeof(glm::vec3));
+	hash = hashBytes(shortIndices.empty() ? NULL : &shortIndices[0], shortIndices.size() * sizeof(unsigned short), hash);
+	return hashBytes(intIndices.empty() ? NULL : &intIndices[0], intIndices.size() * sizeof(unsigned int), hash);
+}
+
+btBvhTriangleMeshShape* CollisionMesh::createShape(const ModelBounds &bounds, std::string cachePath)
+{
+	//the quantization bounds change the BVH so they're part of the key
+	unsigned long long contentHash = hashBytes(&bounds.min[0], sizeof(glm::vec3), hashContents());
+	contentHash = hashBytes(&bounds.max[0], sizeof(glm::vec3), contentHash);
+
+	btBvhTriangleMeshShape *shape = new btBvhTriangleMeshShape(vertexArray, 1, 0);
+	if (loadBvhCache(cachePath, contentHash, shape))
+		return shape;
+	delete shape;
+
+	//no usable cache, build the BVH and the edge info then save them
+	btVector3 aabbMin(bounds.min.x, bounds.min.y, bounds.min.z);
+	btVector3 aabbMax(bounds.max.x, bounds.max.y, bounds.max.z);
+	shape = new btBvhTriangleMeshShape(vertexArray, 1, aabbMin, aabbMax);
+	delete infoMap;
+	infoMap = new btTriangleInfoMap;
+	btGenerateInternalEdgeInfo(shape, infoMap);
+	if (!writeBvhCache(cachePath, contentHash, shape))
+		reportError("Couldn't write BVH cache!(" + cachePath + ")", 0);
+	return shape;
+}
+
+bool CollisionMesh::loadBvhCache(std::string cachePath, unsigned long long contentHash, btBvhTriangleMeshShape *shape)
+{
+	bvhFile.close();
+	//copy on write, deserializing patches pointers into the mapped BVH
+	if (!bvhFile.open(cachePath, 1))
+		return 0;
+
+	const BvhCacheHeader *header = (const BvhCacheHeader*)bvhFile.getData();
+	if (bvhFile.getSize() < sizeof(BvhCacheHeader) ||
+		memcmp(header->magic, BVH_CACHE_MAGIC, 4) != 0 ||
+		header->version != BVH_CACHE_VERSION ||
+		header->contentHash != contentHash ||
+		header->fileSize != bvhFile.getSize())
+	{
+		bvhFile.close();
+		return 0;
+	}
+
+	//the BVH is patched in place and the infos read straight from the mapping, a corrupt offset mustn't leave it
+	//both sections start where the writer aligned them, and there's at most one info per triangle
+	if (header->bvhOffset != alignSection(header->bvhOffset) || header->infoOffset != alignSection(header->infoOffset) ||
+		!inFile(header->bvhOffset, header->bvhSize, 1, header->fileSize) ||
+		!inFile(header->infoOffset, header->infoCount, sizeof(BvhCacheTriangleInfo), header->fileSize) ||
+		header->infoCount > getTriangleCount())
+	{
+		bvhFile.close();
+		return 0;
+	}
+	const BvhCacheTriangleInfo *infos = (const BvhCacheTriangleInfo*)(bvhFile.getData() + header->infoOffset);
+	for (unsigned int i = 0; i < header->infoCount; i++)
+	{
+		//one part, so the key is just the triangle index
+		if (infos[i].key < 0 || (unsigned int)infos[i].key >= getTriangleCount())
+		{
+			bvhFile.close();
+			return 0;
+		}
+	}
+
+	btOptimizedBvh *bvh = btOptimizedBvh::deSerializeInPlace(bvhFile.getWritableData() + header->bvhOffset, header->bvhSize, 0);
+	if (bvh == NULL)
+	{
+		bvhFile.close();
+		return 0;
+	}
+
+	delete infoMap;
+	infoMap = new btTriangleInfoMap;
+	infoMap->m_convexEpsilon = header->infoThresholds[0];
+	infoMap->m_planarEpsilon = header->infoThresholds[1];
+	infoMap->m_equalVertexThreshold = header->infoThresholds[2];
+	infoMap->m_edgeDistanceThreshold = header->infoThresholds[3];
+	infoMap->m_maxEdgeAngleThreshold = header->infoThresholds[4];
+	infoMap->m_zeroAreaThreshold = header->infoThresholds[5];
+	for (unsigned int i = 0; i < header->infoCount; i++)
+	{
+		btTriangleInfo info;
+		info.m_flags = infos[i].flags;
+		info.m_edgeV0V1Angle = infos[i].edgeAngles[0];
+		info.m_edgeV1V2Angle = infos[i].edgeAngles[1];
+		info.m_edgeV2V0Angle = infos[i].edgeAngles[2];
+		infoMap->insert(infos[i].key, info);
+	}
+
+	//the shape doesn't own either, they live as long as this mesh
+	shape->setOptimizedBvh(bvh);
+	shape->setTriangleInfoMap(infoMap);
+	return 1;
+}
+
+bool CollisionMesh::writeBvhCache(std::string cachePath, unsigned long long contentHash, btBvhTriangleMeshShape *shape)
+{
+	btOptimizedBvh *bvh = shape->getOptimizedBvh();
+
+	BvhCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BVH_CACHE_MAGIC, 4);
+	header.version = BVH_CACHE_VERSION;
+	header.contentHash = contentHash;
+	header.bvhOffset = alignSection(sizeof(BvhCacheHeader));
+	header.bvhSize = bvh->calculateSerializeBufferSize();
+	header.infoOffset = alignSection(header.bvhOffset + header.bvhSize);
+	header.infoCount = infoMap->size();
+	header.infoThresholds[0] = infoMap->m_convexEpsilon;
+	header.infoThresholds[1] = infoMap->m_planarEpsilon;
+	header.infoThresholds[2] = infoMap->m_equalVertexThreshold;
+	header.infoThresholds[3] = infoMap->m_edgeDistanceThreshold;
+	header.infoThresholds[4] = infoMap->m_maxEdgeAngleThreshold;
+	header.infoThresholds[5] = infoMap->m_zeroAreaThreshold;
+	header.fileSize = header.infoOffset + header.infoCount * sizeof(BvhCacheTriangleInfo);
+
+	//the serializer wants a 16 byte aligned buffer
+	char *buffer = (char*)btAlignedAlloc(header.fileSize, 16);
+	memset(buffer, 0, header.fileSize);
+	memcpy(buffer, &header, sizeof(header));
+	bool ok = bvh->serializeInPlace(buffer + header.bvhOffset, header.bvhSize, 0);
+
+	BvhCacheTriangleInfo *infos = (BvhCacheTriangleInfo*)(buffer + header.infoOffset);
+	for (unsigned int i = 0; i < header.infoCount; i++)
+	{
+		const btTriangleInfo *info = infoMap->getAtIndex(i);
+		infos[i].key = infoMap->getKeyAtIndex(i).getUid1();
+		infos[i].flags = info->m_flags;
+		infos[i].edgeAngles[0] = info->m_edgeV0V1Angle;
+		infos[i].edgeAngles[1] = info->m_edgeV1V2Angle;
+		infos[i].edgeAngles[2] = info->m_edgeV2V0Angle;
+	}
+
+	if (ok)
+	{
+		std::ofstream out(cachePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		ok = out.is_open();
+		if (ok)
+		{
+			out.write(buffer, header.fileSize);
+			ok = out.good();
+		}
+	}
+	btAlignedFree(buffer);
+	return ok;
+}
+
+size_t CollisionMesh::getMemoryUsage() const
+{
+	return vertices.size() * sizeof(glm::vec3) + shortIndices.size() * sizeof(unsigned short) + intIndices.size() * sizeof(unsigned int);
+}
+
+size_t CollisionMesh::getShapeMemoryUsage(btBvhTriangleMeshShape *shape) const
+{
+	size_t bytes = 0;
+	if (shape->getOptimizedBvh() != NULL)
+		bytes += shape->getOptimizedBvh()->calculateSerializeBufferSize();
+	if (infoMap != NULL)
+		bytes += infoMap->size() * (sizeof(btTriangleInfo) + sizeof(int));
+	return bytes;
+}
+
+//Exact bit pattern of a position, used as the weld key
+struct WeldKey
+{
+	unsigned int bits[3];
+
+	bool operator==(const WeldKey &other) const
+	{ return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2]; }
+};
+
+struct WeldKeyHash
+{
+	size_t operator()(const WeldKey &key) const
+	{ return key.bits[0] * 73856093u ^ key.bits[1] * 19349663u ^ key.bits[2] * 83492791u; }
+};
+
+void weldTriangles(const glm::vec3 *positions, const unsigned int *triangles, unsigned int indexCount, std::vector<glm::vec3> &weldedVertices, std::vector<unsigned int> &weldedIndices)
+{
+	std::unordered_map<WeldKey, unsigned int, WeldKeyHash> unique;
+	unique.reserve(indexCount / 2);
+	weldedVertices.clear();
+	weldedIndices.clear();
+	weldedIndices.reserve(indexCount);
+
+	for (unsigned int t = 0; t + 2 < indexCount; t += 3)
+	{
+		unsigned int tri[3];
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			glm::vec3 pos = positions[triangles[t + k]];
+			//-0 and 0 are the same place
+			for (int c = 0; c < 3; c++)
+			{
+				if (pos[c] == 0.0f)
+					pos[c] = 0.0f;
+			}
+
+			WeldKey key;
+			memcpy(key.bits, &pos[0], sizeof(key.bits));
+			std::unordered_map<WeldKey, unsigned int, WeldKeyHash>::iterator found = unique.find(key);
+			if (found == unique.end())
+			{
+				tri[k] = weldedVertices.size();
+				unique[key] = tri[k];
+				weldedVertices.push_back(pos);
+			}
+			else
+				tri[k] = found->second;
+		}
+
+		//triangles that lost a corner to the weld can't collide with anything
+		if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0])
+			continue;
+		weldedIndices.push_back(tri[0]);
+		weldedIndices.push_back(tri[1]);
+		weldedIndices.push_back(tri[2]);
+	}
+}
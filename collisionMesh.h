@@ -0,0 +1,65 @@
+#ifndef Z_COLMESH
+#define Z_COLMESH
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionShapes/btTriangleInfoMap.h>
+
+#include "mappedFile.h"
+#include "bounds.h"
+
+//Welded, indexed collision geometry that a btTriangleIndexVertexArray reads in place
+class CollisionMesh
+{
+	std::vector<glm::vec3> vertices; //unique positions
+	std::vector<unsigned short> shortIndices; //triangles, used when the vertices fit in 16 bits
+	std::vector<unsigned int> intIndices; //triangles, used otherwise
+	btTriangleIndexVertexArray *vertexArray; //Bullet's view of the above
+	btTriangleInfoMap *infoMap; //internal edge info, stops contacts snagging on edges between triangles
+	MappedFile bvhFile; //cached BVH, deserialized in place so it must stay mapped while the shape lives
+
+	//no copying, Bullet points into the vectors
+	CollisionMesh(const CollisionMesh&);
+	CollisionMesh& operator=(const CollisionMesh&);
+
+	//map a BVH cache and give it to the shape, false if it's missing or for other contents
+	bool loadBvhCache(std::string cachePath, unsigned long long contentHash, btBvhTriangleMeshShape *shape);
+	//save a shape's BVH and the info map
+	bool writeBvhCache(std::string cachePath, unsigned long long contentHash, btBvhTriangleMeshShape *shape);
+public:
+	CollisionMesh(const glm::vec3 *verts, unsigned int vertCount, const unsigned int *inds, unsigned int indCount);
+	~CollisionMesh()
+	{
+		delete infoMap;
+		delete vertexArray;
+	}
+
+	//create the mesh shape, its BVH is quantized to the bounds and loaded from/saved to the cache file
+	btBvhTriangleMeshShape* createShape(const ModelBounds &bounds, std::string cachePath);
+	//hash of the welded triangles, keys the BVH cache
+	unsigned long long hashContents() const;
+
+	//get the mesh interface to build shapes from
+	btTriangleIndexVertexArray* getVertexArray()
+	{ return vertexArray; }
+	//number of triangles
+	unsigned int getTriangleCount() const
+	{ return (shortIndices.size() + intIndices.size()) / 3; }
+	//bytes used by the vertices and indices
+	size_t getMemoryUsage() const;
+	//bytes a shape from createShape adds, its BVH and the internal edge info
+	size_t getShapeMemoryUsage(btBvhTriangleMeshShape *shape) const;
+	//bytes the same triangles take as an unwelded btTriangleMesh
+	size_t getSoupMemoryUsage() const
+	{ return getTriangleCount() * 3 * (sizeof(btVector3) + sizeof(int)); }
+};
+
+//Merge triangle vertices with the exact same position and drop triangles that collapse
+//positions are indexed by triangles, outputs the unique positions and their triangles
+void weldTriangles(const glm::vec3 *positions, const unsigned int *triangles, unsigned int indexCount, std::vector<glm::vec3> &weldedVertices, std::vector<unsigned int> &weldedIndices);
+
+#endif
@@ -2,11 +2,11 @@
 
 const float MOUSESPEED = 0.005f;
 
-void computeMatricesFromInputs(GLFWwindow* window, btDynamicsWorld* world, float* horzAng, float* vertAng, float fov, Entity* ent, glm::mat4* ViewMatrix, glm::mat4* ProjectionMatrix, bool mouseLock)
+void computeMatricesFromInputs(GLFWwindow* window, btDynamicsWorld* world, float* horzAng, float* vertAng, float fov, Entity ent, glm::mat4* ViewMatrix, glm::mat4* ProjectionMatrix, bool mouseLock)
 {
 	static double lastTime = glfwGetTime();
 
-	glm::vec3 orbitPos = ent->getPosition();
+	glm::vec3 orbitPos = ent.getPosition();
 
 	// Get mouse position
 	double xpos, ypos;
@@ -36,22 +36,22 @@ void computeMatricesFromInputs(GLFWwindow* window, btDynamicsWorld* world, float
 	if (glfwGetKey(window, GLFW_KEY_W))
 	{
 		btVector3 btDir = btVector3(-direction.x, direction.y, -direction.z);
-		ent->getRigidBody()->applyForce(btDir, btVector3(0, 5, 0));
+		ent.getRigidBody()->applyForce(btDir, btVector3(0, 5, 0));
 	}
 	if (glfwGetKey(window, GLFW_KEY_S))
 	{
 		btVector3 btDir = btVector3(direction.x, direction.y, direction.z);
-		ent->getRigidBody()->applyForce(btDir, btVector3(0, 5, 0));
+		ent.getRigidBody()->applyForce(btDir, btVector3(0, 5, 0));
 	}
 	if (glfwGetKey(window, GLFW_KEY_A))
 	{
 		btVector3 btDir = btVector3(right.x, right.y, right.z);
-		ent->getRigidBody()->applyForce(btDir, btVector3(0, 5, 0));
+		ent.getRigidBody()->applyForce(btDir, btVector3(0, 5, 0));
 	}
 	if (glfwGetKey(window, GLFW_KEY_D))
 	{
 		btVector3 btDir = btVector3(-right.x, right.y, -right.z);
-		ent->getRigidBody()->applyForce(btDir, btVector3(0, 5, 0));
+		ent.getRigidBody()->applyForce(btDir, btVector3(0, 5, 0));
 	}
 
 	//Control for jumping
@@ -68,7 +68,7 @@ void computeMatricesFromInputs(GLFWwindow* window, btDynamicsWorld* world, float
 			btCollisionObject* obB = const_cast<btCollisionObject*>(contactManifold->getBody1());
 
 			//If neither object is the ball, skip
-			if (obA != ent->getRigidBody() && obB != ent->getRigidBody())
+			if (obA != ent.getRigidBody() && obB != ent.getRigidBody())
 				continue;
 
 			int numContacts = contactManifold->getNumContacts();
@@ -82,7 +82,7 @@ void computeMatricesFromInputs(GLFWwindow* window, btDynamicsWorld* world, float
 		//If found a contact point between the ball and anything, jump away from the thing
 		if (normal != btVector3(0.0f, 0.0f, 0.0f))
 		{
-			ent->getRigidBody()->applyImpulse(normal * 10, btVector3(0, 1, 0));
+			ent.getRigidBody()->applyImpulse(normal * 10, btVector3(0, 1, 0));
 			lastTime = glfwGetTime();
 		}
 	}
@@ -1,12 +1,14 @@
 #version 330 core
 
 // Input vertex data, different for all executions of this shader.
-layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 0) in vec3 vertexPosition_quantized; // 16 bit, normalized to the model's bounds
 
 // Values that stay constant for the whole mesh.
 uniform mat4 depthMVP;
+uniform vec3 PositionDequant[2]; // offset, scale of the model's bounds
 
 void main(){
+	vec3 vertexPosition_modelspace = PositionDequant[0] + PositionDequant[1] * vertexPosition_quantized;
 	gl_Position =  depthMVP * vec4(vertexPosition_modelspace,1);
 }
 
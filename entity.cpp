@@ -1,199 +1,588 @@
+#include <unordered_map>
+#include <algorithm>
+
 #include <btBulletDynamicsCommon.h>
 
 #include "entity.h"
+#include "resourceTracker.h"
+
+//Every entity the manager makes has all four components
+static const unsigned int ENTITY_COMPONENTS = COMPONENT_TRANSFORM | COMPONENT_RENDER | COMPONENT_PHYSICS | COMPONENT_VISIBILITY;
+
+//names the manager's Bullet objects are tracked under
+const char *RIGID_BODIES_NAME = "rigid bodies";
+const char *CUSTOM_SHAPES_NAME = "custom shapes";
+//every entity's body and its motion state
+static const size_t BODY_BYTES = sizeof(btRigidBody) + sizeof(EntityMotionState);
 
-//Draw the model through the model manager
-bool Entity::draw(glm::mat4* proj, glm::mat4* view, bool drawOnlyVerts, GLuint *matID)
+//bytes a shape entities were given uses, by its type since only the base class is known
+static size_t getShapeBytes(btCollisionShape *shape)
 {
-	if (visible)
+	switch (shape->getShapeType())
 	{
-		if (!modMan->draw(modelIndex, textureIndex, pos, rot, scale, proj, view, drawOnlyVerts, matID))
-			return 0;
+	case BOX_SHAPE_PROXYTYPE:
+		return sizeof(btBoxShape);
+	case SPHERE_SHAPE_PROXYTYPE:
+		return sizeof(btSphereShape);
+	case CAPSULE_SHAPE_PROXYTYPE:
+		return sizeof(btCapsuleShape);
+	case CYLINDER_SHAPE_PROXYTYPE:
+		return sizeof(btCylinderShape);
+	case CONE_SHAPE_PROXYTYPE:
+		return sizeof(btConeShape);
+	case STATIC_PLANE_PROXYTYPE:
+		return sizeof(btStaticPlaneShape);
+	case CONVEX_HULL_SHAPE_PROXYTYPE:
+		return sizeof(btConvexHullShape) + ((btConvexHullShape*)shape)->getNumPoints() * sizeof(btVector3);
+	case COMPOUND_SHAPE_PROXYTYPE:
+		return sizeof(btCompoundShape) + ((btCompoundShape*)shape)->getNumChildShapes() * sizeof(btCompoundShapeChild);
+	default:
+		return sizeof(btCollisionShape);
 	}
-	return 1;
 }
-bool Entity::draw(glm::mat4* proj, glm::mat4* view, bool drawOnlyVerts, GLuint *matID, GLuint overrideTex)
+
+//Make an entity and its rigid body
+EntityHandle EntityManager::addEntity(AssetHandle model, AssetHandle texture, glm::vec3 p, glm::quat r, btCollisionShape *col, bool customColShape, btScalar mass, btVector3 *interia)
 {
-	if (visible)
-	{
-		if (!modMan->draw(modelIndex, overrideTex, pos, rot, scale, proj, view, drawOnlyVerts, matID))
-			return 0;
-	}
-	return 1;
+	EntityHandle handle = storage.create(ENTITY_COMPONENTS);
+	unsigned int id = handle.index;
+
+	TransformComponent &transform = storage.getTransform(id);
+	transform.pos = p;
+	transform.rot = r;
+	storage.updateWorld(id);
+
+	RenderComponent &render = storage.getRender(id);
+	render.model = model;
+	render.texture = texture;
+
+	PhysicsComponent &body = storage.getPhysics(id);
+	body.colShape = col;
+	body.customCol = customColShape;
+	body.waitingForShape = 0;
+	//a shared shape is only counted the first time
+	if (customColShape && customShapes.insert(col).second)
+		ResourceTracker::get().add(RESOURCE_PHYSICS_OBJECTS, CUSTOM_SHAPES_NAME, getShapeBytes(col));
+
+	//Create bullet physics stuff, the motion state writes moves back into the transform component
+	EntityMotionState* motionState = new EntityMotionState(&storage, id, btTransform(btQuaternion(r.z, r.x, r.y, r.w), btVector3(p.x, p.y, p.z)));
+	if (mass > 0)
+		col->calculateLocalInertia(mass, *interia);
+	btRigidBody::btRigidBodyConstructionInfo rigidBodyCI(mass, motionState, col, *interia);
+	body.rigidBody = new btRigidBody(rigidBodyCI);
+	//model shapes can be meshes, let the contact callback fix up their internal edges
+	if (!customColShape)
+		body.rigidBody->setCollisionFlags(body.rigidBody->getCollisionFlags() | btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK);
+	dynamicsWorld->addRigidBody(body.rigidBody);
+	ResourceTracker::get().add(RESOURCE_PHYSICS_OBJECTS, RIGID_BODIES_NAME, BODY_BYTES);
+	cullBoundsStale = 1;
+	return handle;
 }
 
-bool EntityManager::createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot)
+EntityHandle EntityManager::createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot)
 {
-	GLuint modelIndex = modMan->newModel(modelFile, 0);
-	GLuint textureIndex = texMan->importTexture(textureFile);
-	Entity newEnt(modMan, modelIndex, textureIndex, pos, rot, modMan->getColShape(modelIndex), 0, 0, &btVector3(0, 0, 0));
-	dynamicsWorld->addRigidBody(newEnt.getRigidBody());
-	allEntities.push_back(newEnt);
-	return 1;
+	AssetHandle model = modMan->newModel(modelFile, 0);
+	if (!model.isValid())
+		return EntityHandle();
+	AssetHandle texture = texMan->importTexture(textureFile);
+	return addEntity(model, texture, pos, rot, modMan->getColShape(model), 0, 0, &btVector3(0, 0, 0));
+}
+
+EntityHandle EntityManager::createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape)
+{
+	AssetHandle model = modMan->newModel(modelFile, colShape == NULL);
+	if (!model.isValid())
+		return EntityHandle();
+	AssetHandle texture = texMan->importTexture(textureFile);
+	if (colShape == NULL)
+		return addEntity(model, texture, pos, rot, modMan->getColShape(model), 0, 0, &btVector3(0, 0, 0));
+	return addEntity(model, texture, pos, rot, colShape, 1, 0, &btVector3(0, 0, 0));
 }
 
-bool EntityManager::createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape)
+EntityHandle EntityManager::createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape, btScalar mass, btVector3 *interia)
 {
-	GLuint modelIndex;
-	Entity* newEnt;
+	AssetHandle model = modMan->newModel(modelFile, 0);
+	if (!model.isValid())
+		return EntityHandle();
+	AssetHandle texture = texMan->importTexture(textureFile);
 	if (colShape == NULL)
+		return addEntity(model, texture, pos, rot, modMan->getColShape(model), 0, mass, interia);
+	return addEntity(model, texture, pos, rot, colShape, 1, mass, interia);
+}
+
+EntityHandle EntityManager::createEntityAsync(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape, btScalar mass, btVector3 *interia)
+{
+	AssetHandle model = modMan->loadModelAsync(modelFile, colShape == NULL);
+	if (!model.isValid())
+		return EntityHandle();
+	AssetHandle texture = texMan->loadTextureAsync(textureFile);
+	EntityHandle handle;
+	if (colShape != NULL)
+		handle = addEntity(model, texture, pos, rot, colShape, 1, mass, interia);
+	else if (modMan->isResident(model))
+		handle = addEntity(model, texture, pos, rot, modMan->getColShape(model), 0, 0, interia);
+	else
 	{
-		modelIndex = modMan->newModel(modelFile, 1);
-		GLuint textureIndex = texMan->importTexture(textureFile);
-		btCollisionShape* meshCol = modMan->getColShape(modelIndex-1);
-		newEnt = new Entity(modMan, modelIndex, textureIndex, pos, rot, meshCol, 0, 0, &btVector3(0, 0, 0));
+		//static body with an empty shape until the collision mesh arrives in updateAll
+		handle = addEntity(model, texture, pos, rot, pendingShape, 0, 0, interia);
+		storage.getPhysics(handle.index).waitingForShape = modMan->isPending(model);
 	}
+	if (modMan->isPending(model))
+		loadingCount++;
+	return handle;
+}
+
+void EntityManager::createEntities(const std::vector<EntityDesc> &descs, std::vector<EntityHandle> &handles, bool async)
+{
+	handles.assign(descs.size(), EntityHandle());
+	if (descs.empty())
+		return;
+
+	//find the unique models and textures, a model needs its mesh shape if any entity using it has no shape of its own
+	std::unordered_map<std::string, unsigned int> modelIds, textureIds;
+	std::vector<std::string> modelFiles, textureFiles;
+	std::vector<unsigned char> meshShapes;
+	std::vector<unsigned int> descModels(descs.size()), descTextures(descs.size());
+	for (unsigned int i = 0; i < descs.size(); i++)
+	{
+		std::pair<std::unordered_map<std::string, unsigned int>::iterator, bool> model =
+			modelIds.insert(std::make_pair(descs[i].modelFile, (unsigned int)modelFiles.size()));
+		if (model.second)
+		{
+			modelFiles.push_back(descs[i].modelFile);
+			meshShapes.push_back(0);
+		}
+		descModels[i] = model.first->second;
+		if (descs[i].colShape == NULL)
+			meshShapes[descModels[i]] = 1;
+
+		std::pair<std::unordered_map<std::string, unsigned int>::iterator, bool> texture =
+			textureIds.insert(std::make_pair(descs[i].textureFile, (unsigned int)textureFiles.size()));
+		if (texture.second)
+			textureFiles.push_back(descs[i].textureFile);
+		descTextures[i] = texture.first->second;
+	}
+
+	//load each once, async loads are all queued before any finishes
+	std::vector<AssetHandle> models(modelFiles.size()), textures;
+	for (unsigned int i = 0; i < modelFiles.size(); i++)
+		models[i] = async ? modMan->loadModelAsync(modelFiles[i], meshShapes[i] != 0) : modMan->newModel(modelFiles[i], meshShapes[i] != 0);
+	if (async)
+		texMan->loadTexturesAsync(textureFiles, textures);
 	else
 	{
-		modelIndex = modMan->newModel(modelFile, 0);
-		GLuint textureIndex = texMan->importTexture(textureFile);
-		newEnt = new Entity(modMan, modelIndex, textureIndex, pos, rot, colShape, 1, 0, &btVector3(0, 0, 0));
+		textures.resize(textureFiles.size());
+		for (unsigned int i = 0; i < textureFiles.size(); i++)
+			textures[i] = texMan->importTexture(textureFiles[i]);
+	}
+
+	//each load came with one reference, the first entity using an asset takes it and the rest add their own
+	std::vector<unsigned char> modelTaken(models.size(), 0), textureTaken(textures.size(), 0);
+
+	//only the storage and the world's body array are reserved, the bodies are still made and added one at a time
+	//Bullet has no bulk insert, every body needs its own broadphase proxy, and destroyEntity frees them one by one
+	storage.reserve(ENTITY_COMPONENTS, descs.size());
+	btCollisionObjectArray &bodies = dynamicsWorld->getCollisionObjectArray();
+	bodies.reserve(bodies.size() + descs.size());
+	for (unsigned int i = 0; i < descs.size(); i++)
+	{
+		const EntityDesc &desc = descs[i];
+		AssetHandle model = models[descModels[i]];
+		if (!model.isValid())
+			continue;
+		if (modelTaken[descModels[i]])
+			modMan->addModelRef(model);
+		modelTaken[descModels[i]] = 1;
+		AssetHandle texture = textures[descTextures[i]];
+		if (textureTaken[descTextures[i]])
+			texMan->addTextureRef(texture);
+		textureTaken[descTextures[i]] = 1;
+
+		btVector3 interia = desc.interia;
+		if (desc.colShape != NULL)
+			handles[i] = addEntity(model, texture, desc.pos, desc.rot, desc.colShape, 1, desc.mass, &interia);
+		else if (modMan->isResident(model))
+			handles[i] = addEntity(model, texture, desc.pos, desc.rot, modMan->getColShape(model), 0, 0, &interia);
+		else
+		{
+			//static body with an empty shape until the collision mesh arrives in updateAll
+			handles[i] = addEntity(model, texture, desc.pos, desc.rot, pendingShape, 0, 0, &interia);
+			storage.getPhysics(handles[i].index).waitingForShape = modMan->isPending(model);
+		}
+		if (modMan->isPending(model))
+			loadingCount++;
+	}
+
+	//textures no entity took, only when every entity using them had a model that failed
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		if (!textureTaken[i])
+			texMan->releaseTexture(textures[i]);
 	}
-	dynamicsWorld->addRigidBody(newEnt->getRigidBody());
-	allEntities.push_back(*newEnt);
-	delete newEnt;
-	return 1;
 }
 
-bool EntityManager::createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape, btScalar mass, btVector3 *interia)
+bool EntityManager::destroyEntity(EntityHandle entity)
 {
-	GLuint modelIndex = modMan->newModel(modelFile, 0);
-	GLuint textureIndex = texMan->importTexture(textureFile);
-	Entity *newEnt;
-	if (colShape == NULL)
-		newEnt = new Entity(modMan, modelIndex, textureIndex, pos, rot, modMan->getColShape(modelIndex), 0, mass, interia);
-	else
-		newEnt = new Entity(modMan, modelIndex, textureIndex, pos, rot, colShape, 1, mass, interia);
-	dynamicsWorld->addRigidBody(newEnt->getRigidBody());
-	allEntities.push_back(*newEnt);
-	delete newEnt;
-	return 1;
+	if (!storage.isLive(entity))
+		return 0;
+	//the body goes first, the world could call its motion state until it's removed
+	btRigidBody *rigid = storage.getPhysics(entity.index).rigidBody;
+	dynamicsWorld->removeRigidBody(rigid);
+	delete rigid->getMotionState();
+	delete rigid;
+	ResourceTracker::get().remove(RESOURCE_PHYSICS_OBJECTS, RIGID_BODIES_NAME, BODY_BYTES);
+	RenderComponent render = storage.getRender(entity.index);
+	modMan->releaseModel(render.model);
+	texMan->releaseTexture(render.texture);
+	//children stay where they are in the hierarchy, as roots
+	scene.removeEntity(entity.index);
+	cullBoundsStale = 1;
+	//a loading entity stays in loadingCount until updateAll counts again
+	return storage.destroy(entity);
 }
 
-//Draw all entities
-bool EntityManager::drawAll(glm::mat4* proj, glm::mat4* view)
+//Pack every drawable row's world bounding sphere, rows still loading never pass the test
+void EntityManager::updateCullBounds()
 {
-	if (allEntities.size() < 1)
-		return 1;
-	for (unsigned int i = 0; i < allEntities.size(); i++)
+	cullBounds.resize(storage.getArchetypeCount());
+	for (unsigned int a = 0; a < storage.getArchetypeCount(); a++)
+	{
+		Archetype &arch = storage.getArchetypeAt(a);
+		CullSpheres &spheres = cullBounds[a];
+		if (!arch.has(COMPONENT_TRANSFORM | COMPONENT_RENDER))
+		{
+			spheres.resize(0);
+			continue;
+		}
+		spheres.resize(arch.size());
+		for (unsigned int i = 0; i < arch.size(); i++)
+			setCullSphere(arch, spheres, i);
+	}
+	cullBoundsStale = 0;
+}
+
+//Refresh the spheres of the rows whose world changed this update, static rows are left alone
+void EntityManager::updateMovedCullBounds()
+{
+	//a full rebuild is already due before the next draw
+	if (cullBoundsStale)
+		return;
+	const std::vector<EntityHandle> &moved = storage.getMoved();
+	const std::vector<unsigned int> &updated = scene.getUpdated();
+	for (unsigned int i = 0; i < moved.size() + updated.size(); i++)
 	{
-		if (!allEntities.at(i).draw(proj, view, 0, NULL))
-			return 0;
+		unsigned int entity = i < moved.size() ? moved[i].index : updated[i - moved.size()];
+		if (!storage.isLive(storage.getHandle(entity)) || !storage.has(entity, COMPONENT_TRANSFORM | COMPONENT_RENDER))
+			continue;
+		const EntityLocation &location = storage.getLocation(entity);
+		setCullSphere(storage.getArchetypeAt(location.archetype), cullBounds[location.archetype], location.row);
 	}
-	return 1;
 }
 
-bool EntityManager::drawAll(glm::mat4* proj, glm::mat4* view, bool b, GLuint *matID)
+//One row's world bounding sphere, hidden until its model is resident
+void EntityManager::setCullSphere(Archetype &arch, CullSpheres &spheres, unsigned int row)
 {
-	if (allEntities.size() < 1)
-		return 1;
-	for (unsigned int i = 0; i < allEntities.size(); i++)
+	AssetHandle model = arch.renders[row].model;
+	if (!modMan->isResident(model))
 	{
-		if (!allEntities.at(i).draw(proj, view, b, matID))
-			return 0;
+		spheres.setHidden(row);
+		return;
 	}
-	return 1;
+	const ModelBounds &bound = modMan->getBounds(model);
+	const glm::vec3 &scale = arch.transforms[row].scale;
+	float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+	glm::vec4 center = arch.worlds[row] * glm::vec4(bound.center, 1.0f);
+	spheres.set(row, glm::vec3(center.x, center.y, center.z), bound.radius * maxScale);
 }
 
-bool EntityManager::drawAll(glm::mat4* proj, glm::mat4* view, bool b, GLuint *matID, GLuint overrideTex)
+//Draw system, walks the archetypes that have what a draw needs and draws the rows inside the frustum
+bool EntityManager::drawEntities(glm::mat4* proj, glm::mat4* view, bool drawOnlyVerts, GLuint *matID)
 {
-	if (allEntities.size() < 1)
+	if (storage.getEntityCount() < 1)
 		return 1;
-	for (unsigned int i = 0; i < allEntities.size(); i++)
+	modMan->beginDraw(proj, view, drawOnlyVerts, matID);
+	if (cullBoundsStale)
+		updateCullBounds();
+	//the camera's perspective frustum or the light's ortho one, tested once for the whole pass
+	Frustum frustum = extractFrustum(*proj * *view);
+	for (unsigned int a = 0; a < storage.getArchetypeCount(); a++)
 	{
-		if (!allEntities.at(i).draw(proj, view, b, matID, overrideTex))
-			return 0;
+		Archetype &arch = storage.getArchetypeAt(a);
+		if (!arch.has(COMPONENT_TRANSFORM | COMPONENT_RENDER | COMPONENT_VISIBILITY))
+			continue;
+		survivors.resize(arch.size());
+		unsigned int survivorCount = cullSpheres(frustum, cullBounds[a], survivors.data());
+		for (unsigned int s = 0; s < survivorCount; s++)
+		{
+			unsigned int i = survivors[s];
+			if (!arch.visibility[i].visible)
+				continue;
+			const glm::vec3 &scale = arch.transforms[i].scale;
+			float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+			const glm::mat4 &world = arch.worlds[i];
+			const RenderComponent &render = arch.renders[i];
+			//streamed textures page in the mips this draw covers
+			if (!drawOnlyVerts)
+				texMan->markUsed(render.texture, modMan->getScreenSize(render.model, world, maxScale, *proj, *view));
+			TextureSlice slice = texMan->getSlice(render.texture);
+			if (!modMan->draw(render.model, slice.array, slice.layer, world, maxScale))
+				return 0;
+		}
 	}
 	return 1;
 }
 
-//Entity constructor
-Entity::Entity(ModelManager *mod, GLuint modI, GLuint texI, glm::vec3 p, glm::quat r, btCollisionShape* col, bool customColShape, btScalar mass, btVector3 *interia)
-{
-	modMan = mod;
-	modelIndex = modI;
-	textureIndex = texI;
-	pos = p;
-	rot = r;
-	scale = glm::vec3(1.0f, 1.0f, 1.0f);
-	visible = 1;
-	colShape = col;
-	customCol = customColShape;
-	//Set to nonmoving if no mass, saves update call
-	if (mass == 0)
-		nonMoving = 1;
-
-	//Create bullet physics stuff
-	btDefaultMotionState* motionState = new btDefaultMotionState(btTransform(btQuaternion(r.z, r.x, r.y, r.w), btVector3(p.x, p.y, p.z)));
-	if (mass > 0)
-		colShape->calculateLocalInertia(mass, *interia);
-	btRigidBody::btRigidBodyConstructionInfo rigidBodyCI(mass, motionState, colShape, *interia);
-	rigidBody = new btRigidBody(rigidBodyCI);
+//Draw all entities
+bool EntityManager::drawAll(glm::mat4* proj, glm::mat4* view)
+{
+	return drawEntities(proj, view, 0, NULL);
+}
+
+bool EntityManager::drawAll(glm::mat4* proj, glm::mat4* view, bool b, GLuint *matID)
+{
+	return drawEntities(proj, view, b, matID);
 }
 
 //EntityManager destructor
 EntityManager::~EntityManager()
 {
-	//Loop through all entities and remove Rigid Bodies and such
-	unsigned int size = allEntities.size();
-	for (unsigned int i = 0; i < size; i++)
+	//Let the workers finish first, they write into the model manager
+	delete workers;
+
+	//Remove every rigid body from the world and delete it
+	for (unsigned int a = 0; a < storage.getArchetypeCount(); a++)
 	{
-		btRigidBody* rigid = allEntities.at(i).getRigidBody();
-		dynamicsWorld->removeRigidBody(rigid);
-		delete rigid->getMotionState();
-		delete rigid;
-		if (allEntities.at(i).getColShape() != NULL)
+		Archetype &arch = storage.getArchetypeAt(a);
+		if (!arch.has(COMPONENT_PHYSICS))
+			continue;
+		for (unsigned int i = 0; i < arch.size(); i++)
 		{
-			//if using custom shape, remove shape from all objects using it and delete it
-			btCollisionShape *shp = allEntities.at(i).getColShape();
-			for (unsigned int i = 0; i < allEntities.size(); i++)
-			{
-				if (allEntities.at(i).getColShape() == shp)
-					allEntities.at(i).setColShape(NULL);
-			}
-			delete shp;
+			btRigidBody* rigid = arch.physics[i].rigidBody;
+			dynamicsWorld->removeRigidBody(rigid);
+			delete rigid->getMotionState();
+			delete rigid;
+			ResourceTracker::get().remove(RESOURCE_PHYSICS_OBJECTS, RIGID_BODIES_NAME, BODY_BYTES);
+		}
+	}
+	//Drop the entities' references to their assets
+	for (unsigned int a = 0; a < storage.getArchetypeCount(); a++)
+	{
+		Archetype &arch = storage.getArchetypeAt(a);
+		if (!arch.has(COMPONENT_RENDER))
+			continue;
+		for (unsigned int i = 0; i < arch.size(); i++)
+		{
+			modMan->releaseModel(arch.renders[i].model);
+			texMan->releaseTexture(arch.renders[i].texture);
 		}
 	}
 	//Delete modelmanager and texturemanager
 	delete modMan;
 	delete texMan;
+	//custom shapes can be shared, delete each once, model shapes belong to the model manager
+	std::unordered_set<btCollisionShape*>::iterator it = customShapes.begin();
+	for (; it != customShapes.end(); ++it)
+	{
+		ResourceTracker::get().remove(RESOURCE_PHYSICS_OBJECTS, CUSTOM_SHAPES_NAME, getShapeBytes(*it));
+		delete *it;
+	}
+	delete pendingShape;
 }
 
 //Update all entities
 void EntityManager::updateAll()
 {
-	for (unsigned int i = 0; i < allEntities.size(); i++)
-		allEntities.at(i).update();
+	//Swap decoded textures in for their placeholders and page streamed mips in and out
+	texMan->processUploads();
+	texMan->updateStreaming();
+
+	//Upload finished models and give waiting bodies their collision mesh
+	if (loadingCount > 0)
+	{
+		modMan->processUploads();
+		unsigned int wasLoading = loadingCount;
+		loadingCount = 0;
+		for (unsigned int a = 0; a < storage.getArchetypeCount(); a++)
+		{
+			Archetype &arch = storage.getArchetypeAt(a);
+			if (!arch.has(COMPONENT_RENDER | COMPONENT_PHYSICS))
+				continue;
+			for (unsigned int i = 0; i < arch.size(); i++)
+			{
+				AssetHandle model = arch.renders[i].model;
+				if (modMan->isPending(model))
+				{
+					loadingCount++;
+					continue;
+				}
+				PhysicsComponent &body = arch.physics[i];
+				//failed models never draw, their bodies keep the empty shape
+				if (body.waitingForShape && !modMan->isResident(model))
+					body.waitingForShape = 0;
+				if (body.waitingForShape)
+				{
+					//swap the shape outside the world so the broadphase picks up the new bounds
+					dynamicsWorld->removeRigidBody(body.rigidBody);
+					body.rigidBody->setCollisionShape(modMan->getColShape(model));
+					body.colShape = body.rigidBody->getCollisionShape();
+					dynamicsWorld->addRigidBody(body.rigidBody);
+					body.waitingForShape = 0;
+				}
+			}
+		}
+		//rows whose model arrived or failed show up or stay hidden from now on
+		if (loadingCount < wasLoading)
+			cullBoundsStale = 1;
+	}
+
+	//Bullet already pushed the moved bodies' transforms through their motion states
+	//hand the list of them to this frame's systems and rebuild only their world matrices
+	storage.flushDirty();
+	storage.updateWorlds();
+	//attached entities under anything that moved follow it, one level at a time
+	scene.propagate(storage, workers);
+	moveAttachedBodies();
+	//both passes cull against this frame's bounds
+	updateMovedCullBounds();
+}
+
+//Put the bodies of the entities propagate moved where their world matrix now is
+void EntityManager::moveAttachedBodies()
+{
+	const std::vector<unsigned int> &updated = scene.getUpdated();
+	for (unsigned int i = 0; i < updated.size(); i++)
+	{
+		unsigned int entity = updated[i];
+		if (!storage.isLive(storage.getHandle(entity)) || !storage.has(entity, COMPONENT_PHYSICS))
+			continue;
+		//the world's scale is divided out so only its rotation is left
+		const glm::mat4 &world = storage.getWorld(entity);
+		glm::mat3 rotation;
+		for (int c = 0; c < 3; c++)
+			rotation[c] = glm::normalize(glm::vec3(world[c][0], world[c][1], world[c][2]));
+		glm::quat rot = glm::quat_cast(rotation);
+		btTransform trans(btQuaternion(rot.x, rot.y, rot.z, rot.w), btVector3(world[3][0], world[3][1], world[3][2]));
+		//static and kinematic bodies only, kinematic ones are read back from their motion state every step
+		btRigidBody *rigidBody = storage.getPhysics(entity).rigidBody;
+		((EntityMotionState*)rigidBody->getMotionState())->setBodyTransform(trans);
+		rigidBody->setWorldTransform(trans);
+	}
+}
+
+bool EntityManager::attach(EntityHandle child, EntityHandle parent)
+{
+	//Bullet moves dynamic bodies itself and writes them back as world space, they can't follow a parent too
+	if (storage.isLive(child) && storage.has(child.index, COMPONENT_PHYSICS) &&
+		!storage.getPhysics(child.index).rigidBody->isStaticOrKinematicObject())
+		return 0;
+	return scene.attach(storage, child, parent);
 }
 
-//Update model position/rotation to Bullet sim object
-void Entity::update()
+//the body has to be in world space even when the transform is relative to a parent
+void Entity::getWorldPose(glm::vec3 &pos, glm::quat &rot)
 {
-	if (nonMoving)
+	EntityStorage &storage = manager->getStorage();
+	const TransformComponent &transform = storage.getTransform(id);
+	pos = transform.pos;
+	rot = transform.rot;
+	unsigned int parent = manager->getScene().getParent(id);
+	if (parent == SceneGraph::NO_PARENT)
 		return;
-	btTransform trans;
-	rigidBody->getMotionState()->getWorldTransform(trans);
-	btVector3 btpos = trans.getOrigin();
-	btQuaternion btrot = trans.getRotation();
-	pos = glm::vec3(btpos.getX(), btpos.getY(), btpos.getZ());
-	rot = glm::quat(btrot.getW(), btrot.getX(), btrot.getY(), btrot.getZ());
+
+	const glm::mat4 &parentWorld = storage.getWorld(parent);
+	glm::vec4 worldPos = parentWorld * glm::vec4(pos, 1.0f);
+	pos = glm::vec3(worldPos.x, worldPos.y, worldPos.z);
+	//the parent's scale is divided out so only its rotation is left
+	glm::mat3 parentRot;
+	for (int i = 0; i < 3; i++)
+		parentRot[i] = glm::normalize(glm::vec3(parentWorld[i][0], parentWorld[i][1], parentWorld[i][2]));
+	rot = glm::quat_cast(parentRot) * rot;
 }
 
 //Set position of model and of bullet object
 void Entity::setPosition(glm::vec3 newPos)
 {
+	EntityStorage &storage = manager->getStorage();
+	storage.getTransform(id).pos = newPos;
+	storage.markDirty(id);
+	glm::vec3 worldPos;
+	glm::quat worldRot;
+	getWorldPose(worldPos, worldRot);
+	btRigidBody *rigidBody = storage.getPhysics(id).rigidBody;
 	btTransform trans;
 	rigidBody->getMotionState()->getWorldTransform(trans);
-	trans.setOrigin(btVector3(newPos.x, newPos.y, newPos.z));
+	trans.setOrigin(btVector3(worldPos.x, worldPos.y, worldPos.z));
 	rigidBody->setWorldTransform(trans);
 }
 
+glm::vec3 Entity::getPosition()
+{
+	return manager->getStorage().getTransform(id).pos;
+}
+
 //set rotation of model and bullet object
 void Entity::setRotation(glm::quat newRot)
 {
-	rot = newRot;
+	EntityStorage &storage = manager->getStorage();
+	storage.getTransform(id).rot = newRot;
+	storage.markDirty(id);
+	glm::vec3 worldPos;
+	glm::quat worldRot;
+	getWorldPose(worldPos, worldRot);
+	btRigidBody *rigidBody = storage.getPhysics(id).rigidBody;
 	btTransform trans;
 	rigidBody->getMotionState()->getWorldTransform(trans);
-	trans.setRotation(btQuaternion(newRot.w, newRot.x, newRot.y, newRot.z));
+	trans.setRotation(btQuaternion(worldRot.w, worldRot.x, worldRot.y, worldRot.z));
 	rigidBody->setWorldTransform(trans);
-}
\ No newline at end of file
+}
+
+glm::quat Entity::getRotation()
+{
+	return manager->getStorage().getTransform(id).rot;
+}
+
+void Entity::setScale(glm::vec3 newScale)
+{
+	manager->getStorage().getTransform(id).scale = newScale;
+	manager->getStorage().markDirty(id);
+}
+
+glm::vec3 Entity::getScale()
+{
+	return manager->getStorage().getTransform(id).scale;
+}
+
+void Entity::setVisible(bool visible)
+{
+	manager->getStorage().getVisibility(id).visible = visible;
+}
+
+bool Entity::isVisible()
+{
+	return manager->getStorage().getVisibility(id).visible;
+}
+
+btCollisionShape* Entity::getColShape()
+{
+	return manager->getStorage().getPhysics(id).colShape;
+}
+
+btRigidBody* Entity::getRigidBody()
+{
+	return manager->getStorage().getPhysics(id).rigidBody;
+}
+
+bool Entity::isCustomShape()
+{
+	return manager->getStorage().getPhysics(id).customCol;
+}
+
+AssetHandle Entity::getModel()
+{
+	return manager->getStorage().getRender(id).model;
+}
+
+AssetHandle Entity::getTexture()
+{
+	return manager->getStorage().getRender(id).texture;
+}
@@ -2,6 +2,7 @@
 #define Z_ENT
 
 #include <vector>
+#include <unordered_set>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -12,118 +13,174 @@
 
 #include "textureManager.h"
 #include "modelManager.h"
+#include "entityStorage.h"
+#include "sceneGraph.h"
+#include "frustum.h"
 
-//Entity class used for all objects in game
+class EntityManager;
+
+//Entity used for all objects in game, a light handle to components in the entity manager's storage
+//cheap to copy, stays valid when the storage grows, must not be used once the entity is destroyed
 class Entity
 {
-	GLuint modelIndex; //Model # from the model manager
-	GLuint textureIndex; //Texture # from the texture manager
-	glm::vec3 pos; //position of the obj
-	glm::quat rot; //rotation of the obj
-	glm::vec3 scale; //scale of the obj
-	bool visible; //if the object is visible
-
-	btCollisionShape *colShape; //collsion shape used in physics
-	bool customCol; //is it using a collsion shape other than the one provided by the model manager?
-	btRigidBody* rigidBody; //rigid body used in physics
-	bool nonMoving; //is the physics body static
+	EntityManager *manager; //entity manager the components live in
+	EntityHandle handle; //entity in the storage
+	unsigned int id; //slot of the entity in the storage
 
-	ModelManager *modMan; //model manager
+	//where the entity is in world space, attached ones go through their parent's last world matrix
+	void getWorldPose(glm::vec3 &pos, glm::quat &rot);
 public:
-	//constructor
-	Entity(ModelManager *mod, GLuint modI, GLuint texI, glm::vec3 p, glm::quat r, btCollisionShape* col, bool customColShape, btScalar mass, btVector3 *interia);
+	Entity(EntityManager *entMan, EntityHandle entity)
+	{
+		manager = entMan;
+		handle = entity;
+		id = entity.index;
+	}
 
-	//Set the positon of the obj
+	//get the entity's handle
+	EntityHandle getHandle()
+	{ return handle; }
+
+	//Set the positon of the obj, relative to its parent if it has one
 	void setPosition(glm::vec3 newPos);
 	//Get the position of the obj
-	glm::vec3 getPosition()
-	{ return pos; }
+	glm::vec3 getPosition();
 
 	//Set the rotation of the obj
 	void setRotation(glm::quat newRot);
 	//Get the rotation of the obj
-	glm::quat getRotation()
-	{ return rot; }
+	glm::quat getRotation();
 
 	//Set the scale of the obj
-	void setScale(glm::vec3 newScale)
-	{ scale = newScale; }
+	void setScale(glm::vec3 newScale);
 	//get the scale of the obj
-	glm::vec3 getScale()
-	{ return scale; }
+	glm::vec3 getScale();
 
-	//set the collision shape of the obj
-	void setColShape(btCollisionShape *shape)
-	{ colShape = shape; }
-	//get the collsion shape of the obj
-	btCollisionShape* getColShape()
-	{ return colShape; }
+	//set if the obj is drawn
+	void setVisible(bool visible);
+	//is the obj drawn
+	bool isVisible();
 
+	//get the collsion shape of the obj
+	btCollisionShape* getColShape();
 	//Get rigid body of obj
-	btRigidBody* getRigidBody()
-	{ return rigidBody; }
-
+	btRigidBody* getRigidBody();
 	//Get if obj using custom collision shape
-	bool isCustomShape()
-	{ return customCol; }
+	bool isCustomShape();
 
 	//Set the restitution of the obj
 	void setRestitution(float res)
-	{ rigidBody->setRestitution(res); }
-
+	{ getRigidBody()->setRestitution(res); }
 	//set the friction of the obj
 	void setFriction(float fric)
-	{ rigidBody->setFriction(fric); }
-
-	//get the model index
-	GLuint getModelIndex()
-	{ return modelIndex; }
+	{ getRigidBody()->setFriction(fric); }
 
-	//draw the obj
-	bool draw(glm::mat4* proj, glm::mat4* view, bool drawOnlyVerts, GLuint *matID);
-	bool draw(glm::mat4* proj, glm::mat4* view, bool drawOnlyVerts, GLuint *matID, GLuint overrideTex);
-	//update the obj
-	void update();
+	//get the model handle
+	AssetHandle getModel();
+	//get the texture handle
+	AssetHandle getTexture();
+};
 
+//What to create an entity from, for creating many at once
+struct EntityDesc
+{
+	std::string modelFile;
+	std::string textureFile;
+	glm::vec3 pos;
+	glm::quat rot;
+	btCollisionShape *colShape; //NULL uses the model's mesh, which makes the entity static
+	btScalar mass;
+	btVector3 interia;
 };
 
 class EntityManager
 {
-	std::vector<Entity> allEntities; //Vector of all the entities
+	EntityStorage storage; //every entity's components, grouped by archetype
+	SceneGraph scene; //which entities follow which
+	std::vector<CullSpheres> cullBounds; //by archetype, every row's world bounding sphere for frustum culling
+	bool cullBoundsStale; //entities were added or removed or a model arrived since cullBounds was built
+	std::vector<unsigned int> survivors; //rows of one archetype that passed the frustum test
+	std::unordered_set<btCollisionShape*> customShapes; //shapes entities were given, can be shared so they live until the manager dies
 	TextureManager *texMan; //Texture manager
 	ModelManager *modMan; //model manager
 	btDynamicsWorld *dynamicsWorld; //dynamics world for physics
+	ThreadPool *workers; //worker threads for async loading
+	btCollisionShape *pendingShape; //placeholder shape for bodies whose collision mesh is still loading
+	unsigned int loadingCount; //entities whose model isn't resident yet
+
+	EntityHandle addEntity(AssetHandle model, AssetHandle texture, glm::vec3 pos, glm::quat rot, btCollisionShape *col, bool customColShape, btScalar mass, btVector3 *interia);
+	void setCullSphere(Archetype &arch, CullSpheres &spheres, unsigned int row);
+	void updateCullBounds();
+	void updateMovedCullBounds();
+	void moveAttachedBodies();
+	bool drawEntities(glm::mat4* proj, glm::mat4* view, bool drawOnlyVerts, GLuint *matID);
 public:
-	EntityManager(GLuint TextureID, GLuint matID, GLuint VMID, GLuint MMID, btDynamicsWorld *dyWorld)
+	EntityManager(GLuint TextureID, GLuint layerID, GLuint matID, GLuint VMID, GLuint MMID, GLuint dequantID, GLuint depthDequantID, btDynamicsWorld *dyWorld)
 	{
-		modMan = new ModelManager(TextureID, matID, VMID, MMID);
-		texMan = new TextureManager;
+		workers = new ThreadPool;
+		modMan = new ModelManager(TextureID, layerID, matID, VMID, MMID, dequantID, depthDequantID, workers);
+		texMan = new TextureManager(workers);
 		dynamicsWorld = dyWorld;
+		pendingShape = new btEmptyShape;
+		loadingCount = 0;
+		cullBoundsStale = 1;
 	};
 	~EntityManager();
 	//get the model manager
 	ModelManager* getModMan()
 	{ return modMan; }
-	//Create entity
-	bool createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot);
-	bool createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape);
-	bool createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape, btScalar mass, btVector3 *interia);
-	//draw all entities
+	//get the texture manager
+	TextureManager* getTexMan()
+	{ return texMan; }
+	//get the component storage, for systems that stream through the archetypes
+	EntityStorage& getStorage()
+	{ return storage; }
+	//get the hierarchy of attached entities
+	SceneGraph& getScene()
+	{ return scene; }
+	//Create entity, returns an invalid handle if the model couldn't be loaded
+	EntityHandle createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot);
+	EntityHandle createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape);
+	EntityHandle createEntity(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape, btScalar mass, btVector3 *interia);
+	//Create entity without waiting for its model or texture, it shows up once the model is loaded
+	//and uses a placeholder texture until its own is decoded
+	//a NULL colShape uses the model's mesh, which only works for static (0 mass) entities
+	EntityHandle createEntityAsync(std::string modelFile, std::string textureFile, glm::vec3 pos, glm::quat rot, btCollisionShape* colShape, btScalar mass, btVector3 *interia);
+	//Create many entities at once, the handles line up with descs and are invalid where the model couldn't be loaded
+	//each model and texture is loaded once however many entities use it and storage is reserved up front
+	//async loads like createEntityAsync, otherwise everything is loaded before it returns
+	void createEntities(const std::vector<EntityDesc> &descs, std::vector<EntityHandle> &handles, bool async);
+	//Remove an entity's body from the world and drop its assets, its slot is reused by the next entity created
+	//returns false if the handle wasn't alive
+	bool destroyEntity(EntityHandle entity);
+	//make child follow parent, its transform becomes relative to parent's and its body is moved with it
+	//returns false if either was destroyed, parent is already under child or child's body is dynamic
+	bool attach(EntityHandle child, EntityHandle parent);
+	//stop an entity following its parent, its transform is in world space again
+	void detach(EntityHandle child)
+	{
+		if (storage.isLive(child))
+			scene.detach(child.index);
+	}
+	//is the handle for an entity that hasn't been destroyed
+	bool isAlive(EntityHandle entity)
+	{ return storage.isLive(entity); }
+	//are any entities still waiting for their model
+	bool isLoading()
+	{ return loadingCount > 0; }
+	//draw all entities inside the view's frustum
 	bool drawAll(glm::mat4* proj, glm::mat4* view);
 	bool drawAll(glm::mat4* proj, glm::mat4* view, bool drawOnlyVerts, GLuint *matID);
-	bool drawAll(glm::mat4* proj, glm::mat4* view, bool drawOnlyVerts, GLuint *matID, GLuint overrideTex);
 	//update all entities
 	void updateAll();
 	//get a certain entity
-	Entity* getEntity(unsigned int index)
-	{ 
-		if (index > allEntities.size()-1)
-			throw "Index above allEntites size.";
-		if (index < 0)
-			throw "Index below 0.";
-
-		return &allEntities.at(index);
+	Entity getEntity(EntityHandle entity)
+	{
+		if (!storage.isLive(entity))
+			throw "Entity was destroyed.";
+
+		return Entity(this, entity);
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,181 @@
+#include "entityStorage.h"
+
+void Archetype::reserve(unsigned int rows)
+{
+	entities.reserve(rows);
+	if (mask & COMPONENT_TRANSFORM)
+	{
+		transforms.reserve(rows);
+		worlds.reserve(rows);
+	}
+	if (mask & COMPONENT_RENDER)
+		renders.reserve(rows);
+	if (mask & COMPONENT_PHYSICS)
+		physics.reserve(rows);
+	if (mask & COMPONENT_VISIBILITY)
+		visibility.reserve(rows);
+}
+
+unsigned int Archetype::addRow(unsigned int entity)
+{
+	entities.push_back(entity);
+	if (mask & COMPONENT_TRANSFORM)
+	{
+		TransformComponent transform;
+		transform.pos = glm::vec3(0.0f);
+		transform.rot = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		transform.scale = glm::vec3(1.0f);
+		transforms.push_back(transform);
+		worlds.push_back(glm::mat4());
+	}
+	if (mask & COMPONENT_RENDER)
+		renders.push_back(RenderComponent());
+	if (mask & COMPONENT_PHYSICS)
+	{
+		PhysicsComponent body = { NULL, NULL, 0, 0 };
+		physics.push_back(body);
+	}
+	if (mask & COMPONENT_VISIBILITY)
+	{
+		VisibilityComponent shown = { 1 };
+		visibility.push_back(shown);
+	}
+	return entities.size() - 1;
+}
+
+void Archetype::removeRow(unsigned int row)
+{
+	unsigned int last = entities.size() - 1;
+	if (row != last)
+	{
+		entities[row] = entities[last];
+		if (mask & COMPONENT_TRANSFORM)
+		{
+			transforms[row] = transforms[last];
+			worlds[row] = worlds[last];
+		}
+		if (mask & COMPONENT_RENDER)
+			renders[row] = renders[last];
+		if (mask & COMPONENT_PHYSICS)
+			physics[row] = physics[last];
+		if (mask & COMPONENT_VISIBILITY)
+			visibility[row] = visibility[last];
+	}
+	entities.pop_back();
+	if (mask & COMPONENT_TRANSFORM)
+	{
+		transforms.pop_back();
+		worlds.pop_back();
+	}
+	if (mask & COMPONENT_RENDER)
+		renders.pop_back();
+	if (mask & COMPONENT_PHYSICS)
+		physics.pop_back();
+	if (mask & COMPONENT_VISIBILITY)
+		visibility.pop_back();
+}
+
+unsigned int EntityStorage::getArchetype(unsigned int mask)
+{
+	for (unsigned int i = 0; i < archetypes.size(); i++)
+	{
+		if (archetypes[i].mask == mask)
+			return i;
+	}
+	Archetype archetype;
+	archetype.mask = mask;
+	archetypes.push_back(archetype);
+	return archetypes.size() - 1;
+}
+
+void EntityStorage::reserve(unsigned int mask, unsigned int count)
+{
+	Archetype &arch = archetypes[getArchetype(mask)];
+	arch.reserve(arch.size() + count);
+	//free slots are reused first
+	if (count > freeSlots.size())
+	{
+		locations.reserve(locations.size() + count - freeSlots.size());
+		dirtyFlags.reserve(dirtyFlags.size() + count - freeSlots.size());
+	}
+}
+
+EntityHandle EntityStorage::create(unsigned int mask)
+{
+	unsigned int entity;
+	if (freeSlots.empty())
+	{
+		entity = locations.size();
+		EntityLocation location;
+		location.generation = 1;
+		locations.push_back(location);
+		dirtyFlags.push_back(0);
+	}
+	else
+	{
+		entity = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	EntityLocation &location = locations[entity];
+	location.archetype = getArchetype(mask);
+	location.row = archetypes[location.archetype].addRow(entity);
+	liveCount++;
+	return EntityHandle(entity, location.generation);
+}
+
+bool EntityStorage::destroy(EntityHandle entity)
+{
+	if (!isLive(entity))
+		return 0;
+	EntityLocation &location = locations[entity.index];
+	Archetype &arch = archetypes[location.archetype];
+	if (location.row + 1 < arch.size())
+		locations[arch.entities.back()].row = location.row;
+	arch.removeRow(location.row);
+
+	location.archetype = NO_ARCHETYPE;
+	//old handles stop matching, skip 0 so a wrapped generation never looks invalid
+	location.generation++;
+	if (location.generation == 0)
+		location.generation = 1;
+	//a stale entry may still be in dirty, flushDirty drops it
+	dirtyFlags[entity.index] = 0;
+	freeSlots.push_back(entity.index);
+	liveCount--;
+	return 1;
+}
+
+void EntityStorage::flushDirty()
+{
+	moved.clear();
+	for (unsigned int i = 0; i < dirty.size(); i++)
+	{
+		dirtyFlags[dirty[i].index] = 0;
+		if (isLive(dirty[i]))
+			moved.push_back(dirty[i]);
+	}
+	dirty.clear();
+}
+
+void EntityStorage::updateWorlds()
+{
+	for (unsigned int i = 0; i < moved.size(); i++)
+	{
+		const EntityLocation &location = locations[moved[i].index];
+		Archetype &arch = archetypes[location.archetype];
+		if (arch.has(COMPONENT_TRANSFORM))
+			arch.worlds[location.row] = arch.transforms[location.row].getMatrix();
+	}
+}
+
+//only dynamic bodies get here and those can't be attached, so the transform is always world space
+void EntityMotionState::setWorldTransform(const btTransform &worldTrans)
+{
+	transform = worldTrans;
+	btVector3 btpos = worldTrans.getOrigin();
+	btQuaternion btrot = worldTrans.getRotation();
+	TransformComponent &dest = storage->getTransform(entity);
+	dest.pos = glm::vec3(btpos.getX(), btpos.getY(), btpos.getZ());
+	dest.rot = glm::quat(btrot.getW(), btrot.getX(), btrot.getY(), btrot.getZ());
+	storage->markDirty(entity);
+}
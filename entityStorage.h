@@ -0,0 +1,228 @@
+#ifndef Z_ENTSTORAGE
+#define Z_ENTSTORAGE
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <btBulletDynamicsCommon.h>
+
+#include "assetRegistry.h"
+
+//Components, each archetype keeps one dense array per component it has
+
+//Where an entity is
+struct TransformComponent
+{
+	glm::vec3 pos;
+	glm::quat rot;
+	glm::vec3 scale;
+
+	//model matrix, scale then rotate then translate
+	glm::mat4 getMatrix() const
+	{ return glm::translate(glm::mat4(), pos) * glm::mat4_cast(rot) * glm::scale(glm::mat4(), scale); }
+};
+
+//What an entity draws with
+struct RenderComponent
+{
+	AssetHandle model; //Model from the model manager
+	AssetHandle texture; //Texture from the texture manager
+};
+
+//An entity's Bullet body
+struct PhysicsComponent
+{
+	btRigidBody *rigidBody;
+	btCollisionShape *colShape; //collision shape used in physics
+	bool customCol; //is it using a collision shape other than the one provided by the model manager?
+	bool waitingForShape; //is the body using a placeholder until the model's collision mesh loads
+};
+
+//Is an entity drawn
+struct VisibilityComponent
+{
+	bool visible;
+};
+
+//Bit per component, an archetype's mask says which ones its entities have
+enum ComponentFlags
+{
+	COMPONENT_TRANSFORM = 1,
+	COMPONENT_RENDER = 2,
+	COMPONENT_PHYSICS = 4,
+	COMPONENT_VISIBILITY = 8
+};
+
+//Every entity with the same set of components, stored as one dense array per component
+//row i of every array belongs to entities[i]
+struct Archetype
+{
+	unsigned int mask; //ComponentFlags
+	std::vector<unsigned int> entities; //entity slot per row
+	std::vector<TransformComponent> transforms;
+	std::vector<glm::mat4> worlds; //cached world matrix per transform, only rebuilt when the transform changes
+	std::vector<RenderComponent> renders;
+	std::vector<PhysicsComponent> physics;
+	std::vector<VisibilityComponent> visibility;
+
+	//does it have all the components in mask
+	bool has(unsigned int components) const
+	{ return (mask & components) == components; }
+	//number of entities
+	unsigned int size() const
+	{ return entities.size(); }
+	//make room for more rows without reallocating
+	void reserve(unsigned int rows);
+	//add a row with default components, returns the row
+	unsigned int addRow(unsigned int entity);
+	//move the last row into a row and drop the last
+	void removeRow(unsigned int row);
+};
+
+//Reference to an entity, stays safe to use after the entity is destroyed and its slot reused
+struct EntityHandle
+{
+	unsigned int index; //slot in the storage
+	unsigned int generation; //bumped every time the slot is freed, 0 is never a live entity
+
+	EntityHandle()
+	{
+		index = 0;
+		generation = 0;
+	}
+	EntityHandle(unsigned int i, unsigned int gen)
+	{
+		index = i;
+		generation = gen;
+	}
+
+	//could this refer to an entity, says nothing about whether it's still alive
+	bool isValid() const
+	{ return generation != 0; }
+	bool operator==(const EntityHandle &other) const
+	{ return index == other.index && generation == other.generation; }
+	bool operator!=(const EntityHandle &other) const
+	{ return !(*this == other); }
+};
+
+//Where an entity's components are
+struct EntityLocation
+{
+	unsigned int archetype; //NO_ARCHETYPE while the slot is free
+	unsigned int row;
+	unsigned int generation; //generation of the handle currently given out
+};
+
+//Archetypes and the lookup from entity slot to row
+//slots of destroyed entities go on a free list, so creating and destroying never shifts other entities' handles
+class EntityStorage
+{
+	std::vector<Archetype> archetypes;
+	std::vector<EntityLocation> locations; //by entity slot
+	std::vector<unsigned int> freeSlots; //destroyed slots waiting to be reused
+	unsigned int liveCount; //entities alive
+	std::vector<unsigned char> dirtyFlags; //by entity slot, is it in dirty
+	std::vector<EntityHandle> dirty; //entities moved since the last flush
+	std::vector<EntityHandle> moved; //entities moved before the last flush
+public:
+	static const unsigned int NO_ARCHETYPE = 0xFFFFFFFF;
+
+	EntityStorage()
+	{ liveCount = 0; }
+
+	//get the archetype for a set of components, making it if it doesn't exist
+	unsigned int getArchetype(unsigned int mask);
+	//make room for count more entities with a set of components, so creating them never reallocates
+	void reserve(unsigned int mask, unsigned int count);
+	//add an entity with a set of components, its slot may be one a destroyed entity used
+	EntityHandle create(unsigned int mask);
+	//remove an entity, the last row of its archetype moves into its place
+	//returns false if the handle wasn't alive
+	bool destroy(EntityHandle entity);
+
+	//is the handle for an entity that's still alive
+	bool isLive(EntityHandle entity) const
+	{
+		return entity.index < locations.size() && entity.generation != 0 && locations[entity.index].generation == entity.generation &&
+			locations[entity.index].archetype != NO_ARCHETYPE;
+	}
+	//number of entities alive
+	unsigned int getEntityCount() const
+	{ return liveCount; }
+	//number of archetypes, systems loop over them and skip the ones missing components they need
+	unsigned int getArchetypeCount() const
+	{ return archetypes.size(); }
+	Archetype& getArchetypeAt(unsigned int index)
+	{ return archetypes[index]; }
+	const EntityLocation& getLocation(unsigned int entity) const
+	{ return locations[entity]; }
+	//get the handle of the entity in a slot, rows only store slots
+	EntityHandle getHandle(unsigned int entity) const
+	{ return EntityHandle(entity, locations[entity].generation); }
+
+	//get one of an entity's components by slot, it must have it
+	TransformComponent& getTransform(unsigned int entity)
+	{ return archetypes[locations[entity].archetype].transforms[locations[entity].row]; }
+	RenderComponent& getRender(unsigned int entity)
+	{ return archetypes[locations[entity].archetype].renders[locations[entity].row]; }
+	PhysicsComponent& getPhysics(unsigned int entity)
+	{ return archetypes[locations[entity].archetype].physics[locations[entity].row]; }
+	VisibilityComponent& getVisibility(unsigned int entity)
+	{ return archetypes[locations[entity].archetype].visibility[locations[entity].row]; }
+	//does the entity have all the components in mask
+	bool has(unsigned int entity, unsigned int components) const
+	{ return archetypes[locations[entity].archetype].has(components); }
+
+	//rebuild the cached world matrix of every entity moved before the last flush
+	void updateWorlds();
+	//get an entity's cached world matrix by slot
+	const glm::mat4& getWorld(unsigned int entity) const
+	{ return archetypes[locations[entity].archetype].worlds[locations[entity].row]; }
+	glm::mat4& getWorld(unsigned int entity)
+	{ return archetypes[locations[entity].archetype].worlds[locations[entity].row]; }
+	//rebuild one entity's world matrix now, for entities that must be right before the next flush
+	void updateWorld(unsigned int entity)
+	{ archetypes[locations[entity].archetype].worlds[locations[entity].row] = getTransform(entity).getMatrix(); }
+
+	//note that an entity's transform changed, once per flush no matter how often it's called
+	void markDirty(unsigned int entity)
+	{
+		if (dirtyFlags[entity])
+			return;
+		dirtyFlags[entity] = 1;
+		dirty.push_back(getHandle(entity));
+	}
+	//hand the dirty entities still alive over to the moved list and start collecting again
+	void flushDirty();
+	//entities whose transform changed before the last flush
+	const std::vector<EntityHandle>& getMoved() const
+	{ return moved; }
+};
+
+//Motion state that pushes Bullet's transforms straight into an entity's transform component
+//Bullet only calls setWorldTransform for bodies that are awake, so sleeping and static ones cost nothing
+class EntityMotionState : public btMotionState
+{
+	btTransform transform; //last transform Bullet set or the starting one
+	EntityStorage *storage;
+	unsigned int entity; //slot, the body is deleted before the slot is reused
+public:
+	EntityMotionState(EntityStorage *entStorage, unsigned int entityId, const btTransform &start)
+	{
+		storage = entStorage;
+		entity = entityId;
+		transform = start;
+	}
+
+	void getWorldTransform(btTransform &worldTrans) const
+	{ worldTrans = transform; }
+	void setWorldTransform(const btTransform &worldTrans);
+	//move the body without writing back into the transform, for bodies that follow a parent
+	void setBodyTransform(const btTransform &worldTrans)
+	{ transform = worldTrans; }
+};
+
+#endif
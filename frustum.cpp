@@ -0,0 +1,111 @@
+#include <math.h>
+
+#include "frustum.h"
+
+#ifdef Z_SSE2
+#include <emmintrin.h>
+#endif
+
+//far enough below every plane that no distance can make up for it
+const float CullSpheres::CULL_HIDDEN_RADIUS = -1e30f;
+
+void CullSpheres::resize(unsigned int sphereCount)
+{
+	count = sphereCount;
+	unsigned int padded = (sphereCount + 3) & ~3u;
+	x.resize(padded);
+	y.resize(padded);
+	z.resize(padded);
+	radius.resize(padded);
+	for (unsigned int i = sphereCount; i < padded; i++)
+		setHidden(i);
+}
+
+Frustum extractFrustum(const glm::mat4 &viewProj)
+{
+	//each plane is the last row of the matrix plus or minus one of the others (Gribb & Hartmann)
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	//unit normals so the distances can be compared with radii
+	for (int i = 0; i < 6; i++)
+	{
+		glm::vec4 &plane = frustum.planes[i];
+		float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f)
+			plane = plane / length;
+	}
+	return frustum;
+}
+
+unsigned int cullSpheresScalar(const Frustum &frustum, const CullSpheres &spheres, unsigned int *survivors)
+{
+	unsigned int survivorCount = 0;
+	for (unsigned int i = 0; i < spheres.count; i++)
+	{
+		bool inside = 1;
+		for (int p = 0; p < 6 && inside; p++)
+		{
+			const glm::vec4 &plane = frustum.planes[p];
+			float distance = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+			inside = distance >= -spheres.radius[i];
+		}
+		if (inside)
+			survivors[survivorCount++] = i;
+	}
+	return survivorCount;
+}
+
+#ifdef Z_SSE2
+unsigned int cullSpheres(const Frustum &frustum, const CullSpheres &spheres, unsigned int *survivors)
+{
+	//every plane's components splatted once
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	unsigned int survivorCount = 0;
+	unsigned int padded = spheres.x.size();
+	for (unsigned int i = 0; i < padded; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&spheres.x[i]);
+		__m128 y = _mm_loadu_ps(&spheres.y[i]);
+		__m128 z = _mm_loadu_ps(&spheres.z[i]);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+
+		//padding is never inside, so every set bit is a real sphere
+		int mask = _mm_movemask_ps(inside);
+		for (unsigned int lane = 0; mask != 0; lane++, mask >>= 1)
+		{
+			if (mask & 1)
+				survivors[survivorCount++] = i + lane;
+		}
+	}
+	return survivorCount;
+}
+#else
+unsigned int cullSpheres(const Frustum &frustum, const CullSpheres &spheres, unsigned int *survivors)
+{
+	return cullSpheresScalar(frustum, spheres, survivors);
+}
+#endif
@@ -0,0 +1,53 @@
+#ifndef Z_FRUSTUM
+#define Z_FRUSTUM
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "simd.h"
+
+//Planes of a view's frustum, normals point inwards, a point p is inside a plane if dot(xyz, p) + w >= 0
+struct Frustum
+{
+	glm::vec4 planes[6]; //left, right, bottom, top, near, far
+};
+
+//World space bounding spheres packed one array per component, so four can be tested at once
+//padded to a multiple of 4 with spheres that are never inside
+struct CullSpheres
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+	unsigned int count; //real spheres, before the padding
+
+	CullSpheres()
+	{ count = 0; }
+	//make room for count spheres and fill the padding
+	void resize(unsigned int sphereCount);
+	void set(unsigned int index, glm::vec3 center, float r)
+	{
+		x[index] = center.x;
+		y[index] = center.y;
+		z[index] = center.z;
+		radius[index] = r;
+	}
+	//a sphere that's never inside, for rows that mustn't be drawn
+	void setHidden(unsigned int index)
+	{ set(index, glm::vec3(0.0f), CULL_HIDDEN_RADIUS); }
+
+	static const float CULL_HIDDEN_RADIUS;
+};
+
+//get the frustum of a projection * view matrix, works for perspective and ortho
+Frustum extractFrustum(const glm::mat4 &viewProj);
+
+//write the index of every sphere at least partly inside the frustum to survivors, returns how many
+//survivors needs room for spheres.count, uses SSE2 four spheres at a time where the compiler targets it
+unsigned int cullSpheres(const Frustum &frustum, const CullSpheres &spheres, unsigned int *survivors);
+//same test one sphere at a time, for comparing against
+unsigned int cullSpheresScalar(const Frustum &frustum, const CullSpheres &spheres, unsigned int *survivors);
+
+#endif
@@ -40,6 +40,12 @@ using namespace glm;
 //Include modelManager for model data
 #include "modelManager.h"
 
+//Include benchmarks, turned on in benchmark.h
+#include "benchmark.h"
+
+//Include resource accounting
+#include "resourceTracker.h"
+
 int main()
 {
 	// Initialise GLFW
@@ -90,6 +96,7 @@ int main()
 	// Cull triangles which normal is not towards the camera
 	glEnable(GL_CULL_FACE);
 
+	//VAO for the debug quad, models bring their own
 	GLuint VertexArrayID;
 	glGenVertexArrays(1, &VertexArrayID);
 	glBindVertexArray(VertexArrayID);
@@ -99,6 +106,7 @@ int main()
 
 	// Get a handle for our "MVP" uniform
 	GLuint depthMatrixID = glGetUniformLocation(depthProgramID, "depthMVP");
+	GLuint depthDequantID = glGetUniformLocation(depthProgramID, "PositionDequant");
 
 	// ---------------------------------------------
 	// Render to Texture - specific code begins here
@@ -114,6 +122,7 @@ int main()
 	glGenTextures(1, &depthTexture);
 	glBindTexture(GL_TEXTURE_2D, depthTexture);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, 1024, 1024, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+	ResourceTracker::get().add(RESOURCE_RENDER_TARGETS, "shadow map", 1024 * 1024 * 2);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -161,9 +170,11 @@ int main()
 	GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
 	GLuint DepthBiasID = glGetUniformLocation(programID, "DepthBiasMVP");
 	GLuint ShadowMapID = glGetUniformLocation(programID, "shadowMap");
+	GLuint DequantID = glGetUniformLocation(programID, "PositionDequant");
 
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint TextureID = glGetUniformLocation(programID, "myTextureSampler");
+	GLuint TextureLayerID = glGetUniformLocation(programID, "TextureLayer");
 
 	// Get a handle for our "LightPosition" uniform
 	GLuint lightInvDirID = glGetUniformLocation(programID, "LightInvDirection_worldspace");
@@ -173,26 +184,41 @@ int main()
 	btDynamicsWorld* dynamicsWorld = physMan->getDW();
 
 	//Entity Manager
-	EntityManager *entities = new EntityManager(TextureID, MatrixID, ViewMatrixID, ModelMatrixID, dynamicsWorld);
+	EntityManager *entities = new EntityManager(TextureID, TextureLayerID, MatrixID, ViewMatrixID, ModelMatrixID, DequantID, depthDequantID, dynamicsWorld);
+	//block compress textures on import, encoded once then read from the .ztex cache
+	entities->getTexMan()->setCompression(COMPRESS_BC7, ENCODE_NORMAL);
 
 	//btCollisionShape* groundShape = new btBoxShape(btVector3(30, 0.1, 30));
 	btCollisionShape* sphereShape = new btSphereShape(1.0f);
 
-	//create the player ball and the level
-	entities->createEntity("sphere.obj", "checker.png", glm::vec3(0, 3, 0), glm::quat(0, 0, 0, 1), sphereShape, btScalar(1), &btVector3(0, 0, 0));
-	entities->createEntity("ball_testCourse.obj", "test_texture.png", glm::vec3(0, 0, 0), glm::quat(1, 0, 0, 0), NULL); //put NULL in last parameter to have the mesh be the collsion mesh also
+	//create the player ball and the level, both load in the background
+	EntityHandle ball = entities->createEntityAsync("sphere.obj", "checker.png", glm::vec3(0, 3, 0), glm::quat(0, 0, 0, 1), sphereShape, btScalar(1), &btVector3(0, 0, 0));
+	EntityHandle level = entities->createEntityAsync("ball_testCourse.obj", "test_texture.png", glm::vec3(0, 0, 0), glm::quat(1, 0, 0, 0), NULL, 0, &btVector3(0, 0, 0)); //put NULL in colShape to have the mesh be the collsion mesh also
+
+#ifdef RUN_BENCHMARKS
+	//wait for the level to load, then benchmark its collision mesh
+	while (entities->isLoading())
+		entities->updateAll();
+	AssetHandle levelModel = entities->getEntity(level).getModel();
+	benchmarkCollision("ball_testCourse.obj", entities->getModMan()->getCollisionMesh(levelModel), entities->getModMan()->getBounds(levelModel), 100000);
+	benchmarkFrustumCulling("ball_testCourse.obj", entities->getModMan()->getBounds(levelModel), 10000, 1000);
+	while (entities->getTexMan()->isLoading())
+		entities->updateAll();
+	TextureSlice levelTexture = entities->getTexMan()->getSlice(entities->getEntity(level).getTexture());
+	benchmarkTextureSampling("test_texture.png", levelTexture.array, levelTexture.layer, 200);
+#endif
 
 	//Set ball physical properties
-	entities->getEntity(0)->setRestitution(0.8f);
-	entities->getEntity(0)->getRigidBody()->setRollingFriction(0.3f);
-	entities->getEntity(0)->setFriction(0.8f);
+	entities->getEntity(ball).setRestitution(0.8f);
+	entities->getEntity(ball).getRigidBody()->setRollingFriction(0.3f);
+	entities->getEntity(ball).setFriction(0.8f);
 	//Make sure ball doesn't get deactivated by Bullet if resting too long
-	entities->getEntity(0)->getRigidBody()->setActivationState(DISABLE_DEACTIVATION);
+	entities->getEntity(ball).getRigidBody()->setActivationState(DISABLE_DEACTIVATION);
 
 	//set level physical properties
-	entities->getEntity(1)->setRestitution(0.5f);
-	entities->getEntity(1)->setFriction(1);
-	entities->getEntity(1)->getRigidBody()->setRollingFriction(0.5f);
+	entities->getEntity(level).setRestitution(0.5f);
+	entities->getEntity(level).setFriction(1);
+	entities->getEntity(level).getRigidBody()->setRollingFriction(0.5f);
 
 	// For speed computation
 	double lastTime = glfwGetTime();
@@ -210,6 +236,7 @@ int main()
 
 	bool mouseLock = 1;
 	bool L_keyDown = 0;
+	bool P_keyDown = 0;
 
 	try{
 		do{
@@ -224,8 +251,9 @@ int main()
 				lastTime += 1.0;
 			}
 
-			//step the physics
-			dynamicsWorld->stepSimulation(1 / 144.0f, 10);
+			//step the physics, once everything has loaded so the ball doesn't fall through the level
+			if (!entities->isLoading())
+				dynamicsWorld->stepSimulation(1 / 144.0f, 10);
 			entities->updateAll();
 
 			// Render to our framebuffer
@@ -253,7 +281,6 @@ int main()
 			// Send our transformation to the currently bound shader, 
 			// in the "MVP" uniform
 
-			entities->getModMan()->clearDepthMVP();
 			entities->drawAll(&depthProjectionMatrix, &depthViewMatrix, 1, &depthMatrixID);
 
 			// Render to the screen
@@ -281,8 +308,18 @@ int main()
 			else if (!glfwGetKey(window, GLFW_KEY_L))
 				L_keyDown = 0;
 
+			//Dump what every asset uses to resources.json
+			if (glfwGetKey(window, GLFW_KEY_P) && !P_keyDown)
+			{
+				if (ResourceTracker::get().writeJson("resources.json"))
+					std::cout << "Wrote resources.json" << std::endl;
+				P_keyDown = 1;
+			}
+			else if (!glfwGetKey(window, GLFW_KEY_P))
+				P_keyDown = 0;
+
 			// Compute the MVP matrix from keyboard and mouse input
-			computeMatricesFromInputs(window, dynamicsWorld, &horizontalAngle, &verticalAngle, fov, entities->getEntity(0), &ViewMatrix, &ProjectionMatrix, mouseLock);
+			computeMatricesFromInputs(window, dynamicsWorld, &horizontalAngle, &verticalAngle, fov, entities->getEntity(ball), &ViewMatrix, &ProjectionMatrix, mouseLock);
 
 			//glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
 
@@ -296,10 +333,6 @@ int main()
 			//Update and draw all entities
 			entities->drawAll(&ProjectionMatrix, &ViewMatrix, 0, &DepthBiasID);
 
-			glDisableVertexAttribArray(0);
-			glDisableVertexAttribArray(1);
-			glDisableVertexAttribArray(2);
-
 
 			// Optionally render the shadowmap (for debug only)
 
@@ -307,6 +340,7 @@ int main()
 			glViewport(0, 0, 256, 256);
 			// Use our shader
 			glUseProgram(quad_programID);
+			glBindVertexArray(VertexArrayID);
 			// Bind our texture in Texture Unit 0
 			glActiveTexture(GL_TEXTURE0);
 			glBindTexture(GL_TEXTURE_2D, depthTexture);
@@ -347,6 +381,7 @@ int main()
 	glDeleteTextures(1, &TextureID);
 	glDeleteFramebuffers(1, &FramebufferName);
 	glDeleteTextures(1, &depthTexture);
+	ResourceTracker::get().remove(RESOURCE_RENDER_TARGETS, "shadow map", 1024 * 1024 * 2);
 	glDeleteVertexArrays(1, &VertexArrayID);
 
 
@@ -354,6 +389,10 @@ int main()
 	delete entities;
 	delete physMan;
 
+	//everything is freed, whatever is still counted leaked
+	ResourceTracker::get().writeJson("resources.json");
+	ResourceTracker::get().reportLeaks();
+
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
 
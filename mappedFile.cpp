@@ -0,0 +1,112 @@
+#include "mappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+{
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+#else
+	file = -1;
+#endif
+	data = NULL;
+	size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(std::string filepath, bool copyOnWrite)
+{
+	close();
+#ifdef _WIN32
+	file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return 0;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return 0;
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	mapping = CreateFileMappingA(file, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		close();
+		return 0;
+	}
+
+	data = (unsigned char*)MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL)
+	{
+		close();
+		return 0;
+	}
+#else
+	file = ::open(filepath.c_str(), O_RDONLY);
+	if (file < 0)
+		return 0;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		close();
+		return 0;
+	}
+	size = (size_t)info.st_size;
+
+	void *view = mmap(NULL, size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED)
+	{
+		close();
+		return 0;
+	}
+	data = (unsigned char*)view;
+#endif
+	return 1;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (data != NULL)
+		UnmapViewOfFile(data);
+	if (mapping != NULL)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data != NULL)
+		munmap(data, size);
+	if (file >= 0)
+		::close(file);
+	file = -1;
+#endif
+	data = NULL;
+	size = 0;
+}
+
+unsigned long long hashBytes(const void *bytes, size_t size, unsigned long long seed)
+{
+	const unsigned char *b = (const unsigned char*)bytes;
+	unsigned long long hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= b[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
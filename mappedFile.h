@@ -0,0 +1,53 @@
+#ifndef Z_MAPPEDFILE
+#define Z_MAPPEDFILE
+
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+//Read only memory mapping of a whole file
+class MappedFile
+{
+#ifdef _WIN32
+	HANDLE file; //file handle
+	HANDLE mapping; //file mapping handle
+#else
+	int file; //file descriptor
+#endif
+	unsigned char *data; //start of the mapped view
+	size_t size; //size of the file in bytes
+
+	//no copying, the mapping is owned by one object
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+public:
+	MappedFile();
+	~MappedFile();
+
+	//map the file, returns false if it doesn't exist or can't be mapped
+	//copy on write mappings can be written to, changes stay in memory and never reach the file
+	bool open(std::string filepath, bool copyOnWrite = false);
+	//unmap the file
+	void close();
+
+	//get the start of the mapped file
+	const unsigned char* getData() const
+	{ return data; }
+	//get the start of a copy on write mapping
+	unsigned char* getWritableData()
+	{ return data; }
+	//get the size of the mapped file
+	size_t getSize() const
+	{ return size; }
+	//is a file mapped
+	bool isOpen() const
+	{ return data != NULL; }
+};
+
+//64 bit FNV-1a hash of a block of memory
+unsigned long long hashBytes(const void *bytes, size_t size, unsigned long long seed = 14695981039346656037ULL);
+
+#endif
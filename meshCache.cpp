@@ -0,0 +1,196 @@
+#include <fstream>
+#include <string.h>
+
+#include "meshCache.h"
+
+const char MESH_CACHE_MAGIC[4] = { 'Z', 'M', 'S', 'H' };
+const unsigned int MESH_CACHE_VERSION = 8;
+
+//File layout: header, then each section starts 16 byte aligned at its offset
+struct MeshCacheHeader
+{
+	char magic[4];
+	unsigned int version;
+	unsigned long long sourceHash;
+	unsigned int importFlags;
+	unsigned int cookFlags;
+	unsigned int vertexCount;
+	unsigned int indexBytes;
+	unsigned int subMeshCount;
+	unsigned int lodCount;
+	unsigned int colVertexCount;
+	unsigned int colIndexCount;
+	float bounds[10]; //AABB min, AABB max, sphere center, sphere radius
+	unsigned int positionsOffset;
+	unsigned int attributesOffset;
+	unsigned int indicesOffset;
+	unsigned int subMeshesOffset;
+	unsigned int lodsOffset;
+	unsigned int colVerticesOffset;
+	unsigned int colIndicesOffset;
+	unsigned int fileSize;
+};
+
+//round up to the section alignment
+static unsigned int alignSection(unsigned int offset)
+{
+	return (offset + 15) & ~15u;
+}
+
+//does count elements of size bytes starting at offset fit in the file, done in 64 bit so it can't wrap
+static bool inFile(unsigned int offset, unsigned long long count, unsigned long long size, unsigned int fileSize)
+{
+	return offset <= fileSize && count * size <= (unsigned long long)(fileSize - offset);
+}
+
+MeshView getMeshView(const MeshData &data)
+{
+	MeshView view;
+	view.positions = data.packedPositions.empty() ? NULL : &data.packedPositions[0];
+	view.attributes = data.packedAttributes.empty() ? NULL : &data.packedAttributes[0];
+	view.vertexCount = data.packedPositions.size();
+	view.indices = data.indices.empty() ? NULL : &data.indices[0];
+	view.indexBytes = data.indices.size();
+	view.subMeshes = data.subMeshes.empty() ? NULL : &data.subMeshes[0];
+	view.subMeshCount = data.subMeshes.size();
+	view.lods = data.lods.empty() ? NULL : &data.lods[0];
+	view.lodCount = data.lods.size();
+	view.colVertices = data.colVertices.empty() ? NULL : &data.colVertices[0];
+	view.colVertexCount = data.colVertices.size();
+	view.colIndices = data.colIndices.empty() ? NULL : &data.colIndices[0];
+	view.colIndexCount = data.colIndices.size();
+	view.bounds = data.bounds;
+	return view;
+}
+
+MeshCache::MeshCache()
+{
+	view = MeshView();
+}
+
+unsigned long long MeshCache::hashSource(std::string filepath)
+{
+	MappedFile source;
+	if (!source.open(filepath))
+		return 0;
+	return hashBytes(source.getData(), source.getSize());
+}
+
+bool MeshCache::write(std::string cachePath, const MeshData &data, unsigned long long sourceHash, unsigned int importFlags, unsigned int cookFlags)
+{
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.importFlags = importFlags;
+	header.cookFlags = cookFlags;
+	header.vertexCount = data.packedPositions.size();
+	header.indexBytes = data.indices.size();
+	header.subMeshCount = data.subMeshes.size();
+	header.lodCount = data.lods.size();
+	header.colVertexCount = data.colVertices.size();
+	header.colIndexCount = data.colIndices.size();
+	for (int i = 0; i < 3; i++)
+	{
+		header.bounds[i] = data.bounds.min[i];
+		header.bounds[3 + i] = data.bounds.max[i];
+		header.bounds[6 + i] = data.bounds.center[i];
+	}
+	header.bounds[9] = data.bounds.radius;
+
+	header.positionsOffset = alignSection(sizeof(MeshCacheHeader));
+	header.attributesOffset = alignSection(header.positionsOffset + header.vertexCount * sizeof(PackedPosition));
+	header.indicesOffset = alignSection(header.attributesOffset + header.vertexCount * sizeof(PackedAttributes));
+	header.subMeshesOffset = alignSection(header.indicesOffset + header.indexBytes);
+	header.lodsOffset = alignSection(header.subMeshesOffset + header.subMeshCount * sizeof(SubMesh));
+	header.colVerticesOffset = alignSection(header.lodsOffset + header.lodCount * sizeof(MeshLod));
+	header.colIndicesOffset = alignSection(header.colVerticesOffset + header.colVertexCount * sizeof(glm::vec3));
+	header.fileSize = header.colIndicesOffset + header.colIndexCount * sizeof(unsigned int);
+
+	std::vector<char> buffer(header.fileSize, 0);
+	memcpy(&buffer[0], &header, sizeof(header));
+	if (header.vertexCount > 0)
+	{
+		memcpy(&buffer[header.positionsOffset], &data.packedPositions[0], header.vertexCount * sizeof(PackedPosition));
+		memcpy(&buffer[header.attributesOffset], &data.packedAttributes[0], header.vertexCount * sizeof(PackedAttributes));
+	}
+	if (header.indexBytes > 0)
+		memcpy(&buffer[header.indicesOffset], &data.indices[0], header.indexBytes);
+	if (header.subMeshCount > 0)
+		memcpy(&buffer[header.subMeshesOffset], &data.subMeshes[0], header.subMeshCount * sizeof(SubMesh));
+	if (header.lodCount > 0)
+		memcpy(&buffer[header.lodsOffset], &data.lods[0], header.lodCount * sizeof(MeshLod));
+	if (header.colVertexCount > 0)
+		memcpy(&buffer[header.colVerticesOffset], &data.colVertices[0], header.colVertexCount * sizeof(glm::vec3));
+	if (header.colIndexCount > 0)
+		memcpy(&buffer[header.colIndicesOffset], &data.colIndices[0], header.colIndexCount * sizeof(unsigned int));
+
+	std::ofstream out(cachePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return 0;
+	out.write(&buffer[0], buffer.size());
+	return out.good();
+}
+
+bool MeshCache::open(std::string cachePath, unsigned long long sourceHash, unsigned int importFlags, unsigned int cookFlags)
+{
+	close();
+	if (!file.open(cachePath))
+		return 0;
+
+	//check the cache is complete and was cooked from this exact source
+	const MeshCacheHeader *header = (const MeshCacheHeader*)file.getData();
+	if (file.getSize() < sizeof(MeshCacheHeader) ||
+		memcmp(header->magic, MESH_CACHE_MAGIC, 4) != 0 ||
+		header->version != MESH_CACHE_VERSION ||
+		header->sourceHash != sourceHash ||
+		header->importFlags != importFlags ||
+		header->cookFlags != cookFlags ||
+		header->fileSize != file.getSize())
+	{
+		close();
+		return 0;
+	}
+
+	//every section has to lie inside the mapping, a corrupt offset gets the model re-cooked
+	unsigned int fileSize = header->fileSize;
+	if (!inFile(header->positionsOffset, header->vertexCount, sizeof(PackedPosition), fileSize) ||
+		!inFile(header->attributesOffset, header->vertexCount, sizeof(PackedAttributes), fileSize) ||
+		!inFile(header->indicesOffset, header->indexBytes, 1, fileSize) ||
+		!inFile(header->subMeshesOffset, header->subMeshCount, sizeof(SubMesh), fileSize) ||
+		!inFile(header->lodsOffset, header->lodCount, sizeof(MeshLod), fileSize) ||
+		!inFile(header->colVerticesOffset, header->colVertexCount, sizeof(glm::vec3), fileSize) ||
+		!inFile(header->colIndicesOffset, header->colIndexCount, sizeof(unsigned int), fileSize))
+	{
+		close();
+		return 0;
+	}
+
+	const unsigned char *base = file.getData();
+	view.positions = (const PackedPosition*)(base + header->positionsOffset);
+	view.attributes = (const PackedAttributes*)(base + header->attributesOffset);
+	view.vertexCount = header->vertexCount;
+	view.indices = base + header->indicesOffset;
+	view.indexBytes = header->indexBytes;
+	view.subMeshes = (const SubMesh*)(base + header->subMeshesOffset);
+	view.subMeshCount = header->subMeshCount;
+	view.lods = (const MeshLod*)(base + header->lodsOffset);
+	view.lodCount = header->lodCount;
+	view.colVertices = (const glm::vec3*)(base + header->colVerticesOffset);
+	view.colVertexCount = header->colVertexCount;
+	view.colIndices = (const unsigned int*)(base + header->colIndicesOffset);
+	view.colIndexCount = header->colIndexCount;
+	const float *b = header->bounds;
+	view.bounds.min = glm::vec3(b[0], b[1], b[2]);
+	view.bounds.max = glm::vec3(b[3], b[4], b[5]);
+	view.bounds.center = glm::vec3(b[6], b[7], b[8]);
+	view.bounds.radius = b[9];
+	return 1;
+}
+
+void MeshCache::close()
+{
+	file.close();
+	view = MeshView();
+}
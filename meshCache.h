@@ -0,0 +1,103 @@
+#ifndef Z_MESHCACHE
+#define Z_MESHCACHE
+
+#include <vector>
+#include <string>
+
+//Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "mappedFile.h"
+#include "vertexFormat.h"
+#include "bounds.h"
+
+//What was done to a model after import, part of the cache key
+enum MeshCookFlags
+{
+	MESH_COOK_OPTIMIZED = 1 //reordered by the mesh optimizer
+};
+
+//Draw range of one imported mesh inside a model's buffers
+struct SubMesh
+{
+	GLuint indexOffset; //byte offset into the index buffer
+	GLuint indexCount; //number of indices
+	GLint baseVertex; //first vertex of the submesh, added to every index
+	GLuint vertexCount; //number of vertices the submesh uses
+	GLenum indexType; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, whichever fits the vertex count
+};
+
+//Detail level of a model, a run of submeshes drawn instead of the full detail ones
+struct MeshLod
+{
+	GLuint firstSubMesh; //index of its first submesh
+	GLuint subMeshCount; //one per imported mesh
+	float error; //how far the surface may be from the full detail one, in model space
+};
+
+//CPU side copy of an imported model, laid out the way it gets uploaded
+struct MeshData
+{
+	std::vector<glm::vec3> positions; //full precision positions, only used while importing
+	std::vector<VertexAttributes> attributes; //full precision uv/normals, only used while importing
+	std::vector<PackedPosition> packedPositions; //position only stream, all the depth pass needs
+	std::vector<PackedAttributes> packedAttributes; //interleaved uv/normal stream for the main pass
+	std::vector<unsigned char> indices; //every submesh's indices at their own width
+	std::vector<SubMesh> subMeshes; //every LOD's submeshes, LOD 0 first
+	std::vector<MeshLod> lods; //full detail first, then coarser and coarser
+	std::vector<glm::vec3> colVertices; //welded collision vertices
+	std::vector<unsigned int> colIndices; //collision triangles
+	ModelBounds bounds; //the AABB is also the position quantization range
+};
+
+//Pointers to model data, either into a MeshData or straight into a mapped cache file
+struct MeshView
+{
+	const PackedPosition *positions;
+	const PackedAttributes *attributes;
+	unsigned int vertexCount;
+	const unsigned char *indices;
+	unsigned int indexBytes;
+	const SubMesh *subMeshes;
+	unsigned int subMeshCount;
+	const MeshLod *lods;
+	unsigned int lodCount;
+	const glm::vec3 *colVertices;
+	unsigned int colVertexCount;
+	const unsigned int *colIndices;
+	unsigned int colIndexCount;
+	ModelBounds bounds;
+};
+
+//Get a view over data that lives in memory
+MeshView getMeshView(const MeshData &data);
+
+//Cooked binary copy of a model that is memory mapped instead of imported
+class MeshCache
+{
+	MappedFile file; //the mapped cache file
+	MeshView view; //pointers into the mapping
+public:
+	MeshCache();
+
+	//where the cooked copy of a model file lives
+	static std::string getCachePath(std::string filepath)
+	{ return filepath + ".zmesh"; }
+	//hash the source file, the cache is only valid for the same hash
+	static unsigned long long hashSource(std::string filepath);
+	//write a cooked model to disk
+	static bool write(std::string cachePath, const MeshData &data, unsigned long long sourceHash, unsigned int importFlags, unsigned int cookFlags);
+
+	//map a cooked model, fails if missing or built from another source or with other import/cook flags
+	bool open(std::string cachePath, unsigned long long sourceHash, unsigned int importFlags, unsigned int cookFlags);
+	//unmap the cooked model, invalidates the view
+	void close();
+
+	//get the mapped data, only valid while open
+	const MeshView& getView() const
+	{ return view; }
+};
+
+#endif
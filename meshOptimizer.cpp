@@ -0,0 +1,224 @@
+#include <algorithm>
+
+#include "meshOptimizer.h"
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	stats.triangles = indices.size() / 3;
+
+	//cacheTime[v] is the miss counter when v went into the cache, it has been pushed out once cacheSize misses happened after
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<bool> used(vertexCount, 0);
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		unsigned int v = indices[i];
+		if (!used[v])
+		{
+			used[v] = 1;
+			stats.uniqueVertices++;
+		}
+		if (cacheTime[v] == 0 || stats.transformed + 1 - cacheTime[v] > cacheSize)
+		{
+			stats.transformed++;
+			cacheTime[v] = stats.transformed;
+		}
+	}
+	return stats;
+}
+
+//Tipsify, from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab, Barczak 2007)
+void optimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount, std::vector<unsigned int> *clusters, unsigned int cacheSize)
+{
+	unsigned int triCount = indices.size() / 3;
+	if (clusters != NULL)
+		clusters->clear();
+	if (triCount == 0)
+		return;
+
+	//triangles using each vertex
+	std::vector<unsigned int> adjOffset(vertexCount + 1, 0);
+	for (unsigned int i = 0; i < triCount * 3; i++)
+		adjOffset[indices[i] + 1]++;
+	for (unsigned int v = 0; v < vertexCount; v++)
+		adjOffset[v + 1] += adjOffset[v];
+	std::vector<unsigned int> adjTris(triCount * 3);
+	std::vector<unsigned int> fill(adjOffset.begin(), adjOffset.end() - 1);
+	for (unsigned int i = 0; i < triCount * 3; i++)
+		adjTris[fill[indices[i]]++] = i / 3;
+
+	//live[v] is the number of triangles using v that aren't emitted yet
+	std::vector<unsigned int> live(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		live[v] = adjOffset[v + 1] - adjOffset[v];
+
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triCount, 0);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+
+	unsigned int timestamp = cacheSize + 1;
+	unsigned int cursor = 0;
+	int fan = 0;
+	while (live[fan] == 0 && (unsigned int)fan + 1 < vertexCount)
+		fan++;
+
+	if (clusters != NULL)
+		clusters->push_back(0);
+
+	while (fan >= 0)
+	{
+		//emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = adjOffset[fan]; a < adjOffset[fan + 1]; a++)
+		{
+			unsigned int t = adjTris[a];
+			if (emitted[t])
+				continue;
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (timestamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = timestamp++;
+			}
+			emitted[t] = 1;
+		}
+
+		//pick the next fan from the vertices just used, if one will still be in the cache
+		int best = -1;
+		int bestPriority = -1;
+		for (unsigned int c = 0; c < candidates.size(); c++)
+		{
+			unsigned int v = candidates[c];
+			if (live[v] == 0)
+				continue;
+			int priority = 0;
+			if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = timestamp - cacheTime[v];
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				best = v;
+			}
+		}
+
+		if (best < 0)
+		{
+			//dead end, the cache is effectively flushed so a new cluster starts here
+			while (!deadEnd.empty() && best < 0)
+			{
+				unsigned int v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0)
+					best = v;
+			}
+			while (best < 0 && cursor < vertexCount)
+			{
+				if (live[cursor] > 0)
+					best = cursor;
+				cursor++;
+			}
+			if (best >= 0 && clusters != NULL)
+				clusters->push_back(output.size() / 3);
+		}
+		fan = best;
+	}
+
+	indices.swap(output);
+}
+
+//A run of triangles and how much it faces away from the mesh center
+struct Cluster
+{
+	unsigned int start;
+	unsigned int end;
+	float sortKey;
+};
+
+static bool clusterDrawsFirst(const Cluster &a, const Cluster &b)
+{
+	return a.sortKey > b.sortKey;
+}
+
+//Linear speed overdraw ordering from the same paper as Tipsify, clusters are only split at cache flushes
+void optimizeOverdraw(std::vector<unsigned int> &indices, const glm::vec3 *positions, const std::vector<unsigned int> &clusters)
+{
+	unsigned int triCount = indices.size() / 3;
+	if (triCount == 0 || clusters.size() < 2)
+		return;
+
+	//area weighted center of the whole mesh
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		glm::vec3 a = positions[indices[t * 3]], b = positions[indices[t * 3 + 1]], c = positions[indices[t * 3 + 2]];
+		float area = glm::length(glm::cross(b - a, c - a));
+		meshCenter += (a + b + c) * (area / 3.0f);
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+		meshCenter /= meshArea;
+
+	std::vector<Cluster> sorted(clusters.size());
+	for (unsigned int i = 0; i < clusters.size(); i++)
+	{
+		Cluster &cl = sorted[i];
+		cl.start = clusters[i];
+		cl.end = i + 1 < clusters.size() ? clusters[i + 1] : triCount;
+
+		glm::vec3 center(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (unsigned int t = cl.start; t < cl.end; t++)
+		{
+			glm::vec3 a = positions[indices[t * 3]], b = positions[indices[t * 3 + 1]], c = positions[indices[t * 3 + 2]];
+			glm::vec3 n = glm::cross(b - a, c - a);
+			float triArea = glm::length(n);
+			center += (a + b + c) * (triArea / 3.0f);
+			normal += n;
+			area += triArea;
+		}
+		if (area > 0.0f)
+			center /= area;
+		float normalLength = glm::length(normal);
+		if (normalLength > 0.0f)
+			normal /= normalLength;
+		cl.sortKey = glm::dot(center - meshCenter, normal);
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), clusterDrawsFirst);
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	for (unsigned int i = 0; i < sorted.size(); i++)
+		output.insert(output.end(), indices.begin() + sorted[i].start * 3, indices.begin() + sorted[i].end * 3);
+	indices.swap(output);
+}
+
+void optimizeVertexFetch(std::vector<unsigned int> &indices, unsigned int vertexCount, std::vector<unsigned int> &remap)
+{
+	const unsigned int unused = ~0u;
+	remap.assign(vertexCount, unused);
+
+	unsigned int next = 0;
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		unsigned int &r = remap[indices[i]];
+		if (r == unused)
+			r = next++;
+		indices[i] = r;
+	}
+
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == unused)
+			remap[v] = next++;
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef Z_MESHOPT
+#define Z_MESHOPT
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+//Size of the post transform vertex cache the optimizer targets
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+//How well an index buffer uses the post transform vertex cache
+struct VertexCacheStats
+{
+	unsigned int triangles; //number of triangles
+	unsigned int transformed; //vertices that missed the cache
+	unsigned int uniqueVertices; //vertices referenced at least once
+
+	VertexCacheStats()
+	{
+		triangles = 0;
+		transformed = 0;
+		uniqueVertices = 0;
+	}
+	//add another mesh's totals
+	void add(const VertexCacheStats &other)
+	{
+		triangles += other.triangles;
+		transformed += other.transformed;
+		uniqueVertices += other.uniqueVertices;
+	}
+
+	//average cache miss ratio, transformed vertices per triangle (0.5 to 3)
+	float getACMR() const
+	{ return triangles ? float(transformed) / triangles : 0.0f; }
+	//average transform to vertex ratio, transformed vertices per unique vertex (1 is perfect)
+	float getATVR() const
+	{ return uniqueVertices ? float(transformed) / uniqueVertices : 0.0f; }
+};
+
+//Simulate a FIFO vertex cache over an index buffer
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+//Reorder triangles for the vertex cache (Tipsify), fills clusters with the first triangle of each cache flush
+void optimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount, std::vector<unsigned int> *clusters, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+//Reorder the clusters from optimizeVertexCache so outward facing ones draw first, cuts overdraw
+void optimizeOverdraw(std::vector<unsigned int> &indices, const glm::vec3 *positions, const std::vector<unsigned int> &clusters);
+
+//Build a remap that puts vertices in the order the indices first use them, rewrites the indices
+//remap[old vertex] = new vertex, unused vertices go to the end
+void optimizeVertexFetch(std::vector<unsigned int> &indices, unsigned int vertexCount, std::vector<unsigned int> &remap);
+
+//Move vertex data into the order from optimizeVertexFetch
+template <class T>
+void remapVertices(T *vertices, const std::vector<unsigned int> &remap)
+{
+	std::vector<T> copy(vertices, vertices + remap.size());
+	for (unsigned int i = 0; i < remap.size(); i++)
+		vertices[remap[i]] = copy[i];
+}
+
+#endif
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <math.h>
+#include <unordered_map>
+
+#include "meshSimplifier.h"
+
+//Symmetric 4x4 error quadric, measures the summed squared distance of a point to a set of planes
+struct Quadric
+{
+	double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+
+	Quadric()
+	{ a00 = a01 = a02 = a03 = a11 = a12 = a13 = a22 = a23 = a33 = 0.0; }
+
+	//add the plane ax + by + cz + d = 0, (a, b, c) normalized
+	void addPlane(double a, double b, double c, double d)
+	{
+		a00 += a * a; a01 += a * b; a02 += a * c; a03 += a * d;
+		a11 += b * b; a12 += b * c; a13 += b * d;
+		a22 += c * c; a23 += c * d;
+		a33 += d * d;
+	}
+	void add(const Quadric &q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+	}
+	//summed squared distance of a point to the planes
+	double evaluate(const glm::vec3 &p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double error = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+			+ a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+			+ a22 * z * z + 2.0 * a23 * z
+			+ a33;
+		return error > 0.0 ? error : 0.0;
+	}
+};
+
+//Moving every vertex of one position group onto another
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	double cost;
+
+	bool operator<(const Collapse &other) const
+	{ return cost < other.cost; }
+};
+
+//Orders vertex ids by position so equal positions end up next to each other
+struct PositionLess
+{
+	const glm::vec3 *positions;
+
+	PositionLess(const glm::vec3 *p)
+	{ positions = p; }
+	bool operator()(unsigned int a, unsigned int b) const
+	{
+		const glm::vec3 &pa = positions[a];
+		const glm::vec3 &pb = positions[b];
+		if (pa.x != pb.x)
+			return pa.x < pb.x;
+		if (pa.y != pb.y)
+			return pa.y < pb.y;
+		return pa.z < pb.z;
+	}
+};
+
+static glm::vec3 triangleNormal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+{
+	return glm::cross(p1 - p0, p2 - p0);
+}
+
+//how different two vertices at a seam look, picks which vertex a collapsed one turns into
+static float attributeDistance(const VertexAttributes &a, const VertexAttributes &b)
+{
+	glm::vec2 uv = a.uv - b.uv;
+	return glm::dot(uv, uv) + 1.0f - glm::dot(a.normal, b.normal);
+}
+
+float simplifyMesh(const std::vector<unsigned int> &indices, const glm::vec3 *positions, const VertexAttributes *attributes, unsigned int vertexCount,
+	unsigned int targetIndexCount, float maxError, std::vector<unsigned int> &result)
+{
+	result = indices;
+	if (result.size() <= targetIndexCount || vertexCount == 0)
+		return 0.0f;
+
+	//vertices split by uv or normal seams share a position, collapses move the whole group
+	std::vector<unsigned int> order(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), PositionLess(positions));
+	std::vector<unsigned int> groupOf(vertexCount);
+	std::vector<unsigned int> groupStart; //members of group g are order[groupStart[g]] to order[groupStart[g + 1] - 1]
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		if (i == 0 || positions[order[i]] != positions[order[i - 1]])
+			groupStart.push_back(i);
+		groupOf[order[i]] = groupStart.size() - 1;
+	}
+	unsigned int groupCount = groupStart.size();
+	groupStart.push_back(vertexCount);
+
+	//every triangle's plane goes into the quadrics of its corners
+	std::vector<Quadric> quadrics(groupCount);
+	std::unordered_map<unsigned long long, unsigned int> edgeUse;
+	for (unsigned int t = 0; t + 2 < result.size(); t += 3)
+	{
+		const glm::vec3 &p0 = positions[result[t]];
+		glm::vec3 normal = triangleNormal(p0, positions[result[t + 1]], positions[result[t + 2]]);
+		float length = glm::length(normal);
+		if (length > 0.0f)
+		{
+			normal /= length;
+			for (unsigned int k = 0; k < 3; k++)
+				quadrics[groupOf[result[t + k]]].addPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+		}
+
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			unsigned long long a = groupOf[result[t + k]];
+			unsigned long long b = groupOf[result[t + (k + 1) % 3]];
+			edgeUse[a < b ? (a << 32) | b : (b << 32) | a]++;
+		}
+	}
+
+	//vertices on edges only one triangle uses are on an open border, they stay put to keep the outline
+	std::vector<bool> locked(groupCount, false);
+	for (std::unordered_map<unsigned long long, unsigned int>::iterator it = edgeUse.begin(); it != edgeUse.end(); ++it)
+	{
+		if (it->second == 1)
+		{
+			locked[(unsigned int)(it->first >> 32)] = true;
+			locked[(unsigned int)(it->first & 0xffffffffu)] = true;
+		}
+	}
+
+	double maxCost = double(maxError) * maxError;
+	double worstCost = 0.0;
+	std::vector<unsigned int> collapseTo(groupCount);
+	std::vector<bool> touched(groupCount);
+	std::vector<unsigned int> triangleStart(groupCount + 1);
+	std::vector<unsigned int> groupTriangles;
+	std::vector<unsigned int> vertexRemap(vertexCount);
+	std::vector<Collapse> collapses;
+
+	//each pass does the cheapest collapses that don't touch each other, then rebuilds
+	while (result.size() > targetIndexCount)
+	{
+		unsigned int triangleCount = result.size() / 3;
+
+		//triangles around each group
+		std::fill(triangleStart.begin(), triangleStart.end(), 0);
+		for (unsigned int i = 0; i < result.size(); i++)
+			triangleStart[groupOf[result[i]] + 1]++;
+		for (unsigned int g = 0; g < groupCount; g++)
+			triangleStart[g + 1] += triangleStart[g];
+		groupTriangles.resize(result.size());
+		std::vector<unsigned int> cursor(triangleStart.begin(), triangleStart.end() - 1);
+		for (unsigned int i = 0; i < result.size(); i++)
+			groupTriangles[cursor[groupOf[result[i]]]++] = i / 3;
+
+		//both directions of every edge, cheapest first
+		collapses.clear();
+		for (unsigned int t = 0; t < result.size(); t += 3)
+		{
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				unsigned int a = groupOf[result[t + k]];
+				unsigned int b = groupOf[result[t + (k + 1) % 3]];
+				Quadric q = quadrics[a];
+				q.add(quadrics[b]);
+				if (!locked[a])
+				{
+					Collapse c = { a, b, q.evaluate(positions[order[groupStart[b]]]) };
+					collapses.push_back(c);
+				}
+				if (!locked[b])
+				{
+					Collapse c = { b, a, q.evaluate(positions[order[groupStart[a]]]) };
+					collapses.push_back(c);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		for (unsigned int g = 0; g < groupCount; g++)
+		{
+			collapseTo[g] = g;
+			touched[g] = false;
+		}
+		unsigned int removed = 0;
+		unsigned int accepted = 0;
+		for (unsigned int i = 0; i < collapses.size(); i++)
+		{
+			const Collapse &c = collapses[i];
+			if (c.cost > maxCost || triangleCount - removed <= targetIndexCount / 3)
+				break;
+			if (touched[c.from] || touched[c.to])
+				continue;
+
+			//reject collapses that would flip a surviving triangle
+			const glm::vec3 &target = positions[order[groupStart[c.to]]];
+			unsigned int shared = 0;
+			bool flips = false;
+			for (unsigned int j = triangleStart[c.from]; j < triangleStart[c.from + 1] && !flips; j++)
+			{
+				const unsigned int *tri = &result[groupTriangles[j] * 3];
+				glm::vec3 p[3];
+				bool hasTarget = false;
+				for (unsigned int k = 0; k < 3; k++)
+				{
+					p[k] = positions[tri[k]];
+					hasTarget = hasTarget || groupOf[tri[k]] == c.to;
+				}
+				if (hasTarget)
+				{
+					shared++;
+					continue;
+				}
+
+				glm::vec3 before = triangleNormal(p[0], p[1], p[2]);
+				for (unsigned int k = 0; k < 3; k++)
+				{
+					if (groupOf[tri[k]] == c.from)
+						p[k] = target;
+				}
+				glm::vec3 after = triangleNormal(p[0], p[1], p[2]);
+				flips = glm::dot(before, after) <= 0.0f;
+			}
+			if (flips || shared == 0)
+				continue;
+
+			collapseTo[c.from] = c.to;
+			worstCost = std::max(worstCost, c.cost);
+			removed += shared;
+			accepted++;
+			//the neighbourhood changes shape, leave it alone until the next pass
+			for (unsigned int j = triangleStart[c.from]; j < triangleStart[c.from + 1]; j++)
+			{
+				const unsigned int *tri = &result[groupTriangles[j] * 3];
+				for (unsigned int k = 0; k < 3; k++)
+					touched[groupOf[tri[k]]] = true;
+			}
+		}
+		if (accepted == 0)
+			break;
+
+		//each collapsed vertex turns into the vertex at the target that looks most like it
+		for (unsigned int v = 0; v < vertexCount; v++)
+			vertexRemap[v] = v;
+		for (unsigned int g = 0; g < groupCount; g++)
+		{
+			unsigned int to = collapseTo[g];
+			if (to == g)
+				continue;
+			quadrics[to].add(quadrics[g]);
+			for (unsigned int i = groupStart[g]; i < groupStart[g + 1]; i++)
+			{
+				unsigned int v = order[i];
+				float best = 0.0f;
+				for (unsigned int j = groupStart[to]; j < groupStart[to + 1]; j++)
+				{
+					float distance = attributeDistance(attributes[v], attributes[order[j]]);
+					if (j == groupStart[to] || distance < best)
+					{
+						best = distance;
+						vertexRemap[v] = order[j];
+					}
+				}
+			}
+		}
+
+		//rewrite the triangles, dropping the ones that collapsed
+		unsigned int write = 0;
+		for (unsigned int t = 0; t < result.size(); t += 3)
+		{
+			unsigned int a = vertexRemap[result[t]];
+			unsigned int b = vertexRemap[result[t + 1]];
+			unsigned int c = vertexRemap[result[t + 2]];
+			if (groupOf[a] == groupOf[b] || groupOf[b] == groupOf[c] || groupOf[c] == groupOf[a])
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	return (float)sqrt(worstCost);
+}
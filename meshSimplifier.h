@@ -0,0 +1,19 @@
+#ifndef Z_MESHSIMPLIFY
+#define Z_MESHSIMPLIFY
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vertexFormat.h"
+
+//Number of LODs generated per model, including the full detail one
+const unsigned int MAX_MESH_LODS = 4;
+
+//Collapse edges by quadric error until the mesh is down to targetIndexCount indices or no collapse stays under maxError
+//only ever picks existing vertices so the result indexes the same vertex buffer, open borders are kept
+//returns the largest error (a model space distance) any collapse introduced
+float simplifyMesh(const std::vector<unsigned int> &indices, const glm::vec3 *positions, const VertexAttributes *attributes, unsigned int vertexCount,
+	unsigned int targetIndexCount, float maxError, std::vector<unsigned int> &result);
+
+#endif
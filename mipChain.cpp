@@ -0,0 +1,96 @@
+#include <string.h>
+#include <algorithm>
+
+#include "mipChain.h"
+
+#ifdef Z_SSE2
+#include <emmintrin.h>
+#endif
+
+//average a 2x2 block of RGBA8 pixels, the last two may be the same as the first two on odd edges
+static inline void averageBlock(const unsigned char *a0, const unsigned char *a1, const unsigned char *b0, const unsigned char *b1, unsigned char *out)
+{
+	for (int c = 0; c < 4; c++)
+		out[c] = (unsigned char)((a0[c] + a1[c] + b0[c] + b1[c] + 2) >> 2);
+}
+
+void downsampleRGBA(const unsigned char *src, int srcWidth, int srcHeight, unsigned char *dst)
+{
+	int dstWidth = std::max(1, srcWidth / 2);
+	int dstHeight = std::max(1, srcHeight / 2);
+
+	for (int y = 0; y < dstHeight; y++)
+	{
+		const unsigned char *row0 = src + (size_t)std::min(2 * y, srcHeight - 1) * srcWidth * 4;
+		const unsigned char *row1 = src + (size_t)std::min(2 * y + 1, srcHeight - 1) * srcWidth * 4;
+		unsigned char *out = dst + (size_t)y * dstWidth * 4;
+		int x = 0;
+
+#ifdef Z_SSE2
+		//4 output pixels from 8 input pixels of each row per step
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi16(2);
+		for (; x + 4 <= dstWidth && 2 * x + 8 <= srcWidth; x += 4)
+		{
+			__m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+			__m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + x * 8 + 16));
+			__m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + x * 8 + 16));
+
+			//vertical sums, two pixels per register at 16 bits a channel
+			__m128i p01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+			__m128i p23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+			__m128i p45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+			__m128i p67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+			//horizontal sums, each neighbour pair ends up in the low half
+			p01 = _mm_add_epi16(p01, _mm_srli_si128(p01, 8));
+			p23 = _mm_add_epi16(p23, _mm_srli_si128(p23, 8));
+			p45 = _mm_add_epi16(p45, _mm_srli_si128(p45, 8));
+			p67 = _mm_add_epi16(p67, _mm_srli_si128(p67, 8));
+
+			__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(p01, p23), round), 2);
+			__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(p45, p67), round), 2);
+			_mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi16(lo, hi));
+		}
+#endif
+
+		for (; x < dstWidth; x++)
+		{
+			int x0 = std::min(2 * x, srcWidth - 1) * 4;
+			int x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+			averageBlock(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out + x * 4);
+		}
+	}
+}
+
+void buildMipChain(const unsigned char *image, int width, int height, MipChain &chain)
+{
+	chain.format = TEXTURE_RGBA8;
+	chain.levels.clear();
+	size_t total = 0;
+	int w = width;
+	int h = height;
+	while (true)
+	{
+		MipLevel level;
+		level.width = w;
+		level.height = h;
+		level.offset = total;
+		level.size = (size_t)w * h * 4;
+		chain.levels.push_back(level);
+		total += level.size;
+		if (w == 1 && h == 1)
+			break;
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+
+	chain.pixels.resize(total);
+	memcpy(&chain.pixels[0], image, chain.levels[0].size);
+	for (unsigned int i = 1; i < chain.levels.size(); i++)
+	{
+		const MipLevel &src = chain.levels[i - 1];
+		downsampleRGBA(&chain.pixels[src.offset], src.width, src.height, &chain.pixels[chain.levels[i].offset]);
+	}
+}
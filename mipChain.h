@@ -0,0 +1,52 @@
+#ifndef Z_MIPCHAIN
+#define Z_MIPCHAIN
+
+#include <vector>
+#include <stddef.h>
+
+#include "simd.h"
+
+//How a texture's pixels are stored
+enum TextureFormat
+{
+	TEXTURE_RGBA8, //4 bytes a pixel
+	TEXTURE_BC1, //8 bytes a 4x4 block, RGB
+	TEXTURE_BC3, //16 bytes a 4x4 block, RGB plus separate alpha
+	TEXTURE_BC7 //16 bytes a 4x4 block, RGBA, higher quality
+};
+
+//One level of a mip chain
+struct MipLevel
+{
+	int width;
+	int height;
+	size_t offset; //byte offset into the chain's pixels
+	size_t size; //bytes in the level
+};
+
+//An image and every mip below it, down to 1x1, RGBA8 or block compressed
+struct MipChain
+{
+	TextureFormat format;
+	std::vector<MipLevel> levels; //full size first
+	std::vector<unsigned char> pixels; //every level back to back
+
+	MipChain()
+	{ format = TEXTURE_RGBA8; }
+
+	//get the pixels of a level
+	const unsigned char* getLevel(unsigned int level) const
+	{ return &pixels[levels[level].offset]; }
+	//number of levels
+	unsigned int getLevelCount() const
+	{ return levels.size(); }
+};
+
+//Halve an RGBA8 image with a 2x2 box filter, odd edges reuse their last row/column
+//dst is (srcWidth / 2) x (srcHeight / 2), at least 1x1
+void downsampleRGBA(const unsigned char *src, int srcWidth, int srcHeight, unsigned char *dst);
+
+//Copy an RGBA8 image into a chain and box filter it down to 1x1
+void buildMipChain(const unsigned char *image, int width, int height, MipChain &chain);
+
+#endif
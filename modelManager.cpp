@@ -1,164 +1,612 @@
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+
 #include "modelManager.h"
 
-//see if model already imported, if so return that number
-GLuint ModelManager::checkIfModelExists(std::string filepath)
+//Assimp post processing used for every model, part of the mesh cache key
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_FlipUVs | aiProcess_Triangulate;
+
+//Largest error one LOD step may add, as a fraction of the model's bounding radius
+const float LOD_MAX_STEP_ERROR = 0.05f;
+//Stop adding LODs once a step keeps more than this fraction of the triangles
+const float LOD_MIN_REDUCTION = 0.8f;
+
+//pack a submesh's indices at the smallest width that can address its vertices
+static void appendSubMesh(MeshData &data, const std::vector<unsigned int> &localIndices, unsigned int baseVertex, unsigned int vertexCount)
+{
+	SubMesh sub;
+	sub.indexCount = localIndices.size();
+	sub.baseVertex = baseVertex;
+	sub.vertexCount = vertexCount;
+	sub.indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	//keep every submesh 4 byte aligned so either width can follow
+	while (data.indices.size() % 4 != 0)
+		data.indices.push_back(0);
+	sub.indexOffset = data.indices.size();
+
+	if (sub.indexType == GL_UNSIGNED_SHORT)
+	{
+		data.indices.resize(sub.indexOffset + sub.indexCount * sizeof(unsigned short));
+		unsigned short *out = sub.indexCount > 0 ? (unsigned short*)&data.indices[sub.indexOffset] : NULL;
+		for (unsigned int i = 0; i < sub.indexCount; i++)
+			out[i] = (unsigned short)localIndices[i];
+	}
+	else
+	{
+		data.indices.resize(sub.indexOffset + sub.indexCount * sizeof(unsigned int));
+		if (sub.indexCount > 0)
+			memcpy(&data.indices[sub.indexOffset], &localIndices[0], sub.indexCount * sizeof(unsigned int));
+	}
+
+	data.subMeshes.push_back(sub);
+}
+
+//Indices of one imported mesh before they get packed into the model's index buffer
+struct ImportedMesh
 {
-	if (filenames.size() < 1)
-		return -1;
+	std::vector<unsigned int> indices; //relative to baseVertex
+	unsigned int baseVertex;
+	unsigned int vertexCount;
+};
 
-	for (GLuint i = 0; i < filenames.size(); i++)
+//add every mesh under a node (and its children) to the model, in model space
+static void importNode(const aiScene *scene, const aiNode *node, aiMatrix4x4 parentTransform, MeshData &data, std::vector<ImportedMesh> &meshes)
+{
+	aiMatrix4x4 transform = parentTransform * node->mTransformation;
+	aiMatrix3x3 normalTransform = aiMatrix3x3(transform);
+	normalTransform.Inverse().Transpose();
+
+	for (unsigned int m = 0; m < node->mNumMeshes; m++)
 	{
-		if (!filepath.compare(filenames.at(i)))
-			return i;
+		const aiMesh *mesh = scene->mMeshes[node->mMeshes[m]];
+		unsigned int baseVertex = data.positions.size();
+
+		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+		{
+			aiVector3D pos = transform * mesh->mVertices[i];
+			data.positions.push_back(glm::vec3(pos.x, pos.y, pos.z));
+
+			VertexAttributes attrib;
+			attrib.uv = glm::vec2(0.0f, 0.0f);
+			attrib.normal = glm::vec3(0.0f, 0.0f, 0.0f);
+			if (mesh->HasTextureCoords(0))
+			{
+				aiVector3D UVW = mesh->mTextureCoords[0][i];
+				attrib.uv = glm::vec2(UVW.x, UVW.y);
+			}
+			if (mesh->HasNormals())
+			{
+				aiVector3D n = normalTransform * mesh->mNormals[i];
+				attrib.normal = glm::normalize(glm::vec3(n.x, n.y, n.z));
+			}
+			data.attributes.push_back(attrib);
+		}
+
+		//points and lines are left out, the renderer only draws triangles
+		meshes.push_back(ImportedMesh());
+		ImportedMesh &imported = meshes.back();
+		imported.baseVertex = baseVertex;
+		imported.vertexCount = mesh->mNumVertices;
+		imported.indices.reserve(3 * mesh->mNumFaces);
+		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+		{
+			if (mesh->mFaces[i].mNumIndices != 3)
+				continue;
+			imported.indices.push_back(mesh->mFaces[i].mIndices[0]);
+			imported.indices.push_back(mesh->mFaces[i].mIndices[1]);
+			imported.indices.push_back(mesh->mFaces[i].mIndices[2]);
+		}
 	}
-	return -1;
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		importNode(scene, node->mChildren[i], transform, data, meshes);
 }
 
-//load new model into opengl
-GLuint ModelManager::newModel(std::string filepath, bool useMeshAsColShape)
+//reorder a mesh's triangles for the vertex cache and overdraw, then its vertices for fetch locality
+static void optimizeMesh(MeshData &data, ImportedMesh &mesh, VertexCacheStats &before, VertexCacheStats &after)
 {
-	GLuint precheck = checkIfModelExists(filepath);
-	if (precheck != -1)
-		return precheck;
+	if (mesh.indices.empty())
+		return;
+	before.add(analyzeVertexCache(mesh.indices, mesh.vertexCount));
 
-	Assimp::Importer importer;
+	std::vector<unsigned int> clusters;
+	optimizeVertexCache(mesh.indices, mesh.vertexCount, &clusters);
+	optimizeOverdraw(mesh.indices, &data.positions[mesh.baseVertex], clusters);
+
+	std::vector<unsigned int> remap;
+	optimizeVertexFetch(mesh.indices, mesh.vertexCount, remap);
+	remapVertices(&data.positions[mesh.baseVertex], remap);
+	remapVertices(&data.attributes[mesh.baseVertex], remap);
 
-	std::vector<unsigned short> ind;
-	std::vector<glm::vec3> vert;
-	std::vector<glm::vec2> uv;
-	std::vector<glm::vec3> norm;
+	after.add(analyzeVertexCache(mesh.indices, mesh.vertexCount));
+}
+
+//read a model file with Assimp into a MeshData
+bool ModelManager::importModel(std::string filepath, MeshData &data, bool optimize)
+{
+	Assimp::Importer importer;
 
-	const aiScene* scene = importer.ReadFile(filepath, aiProcess_FlipUVs);
-	if (!scene)
+	const aiScene* scene = importer.ReadFile(filepath, MODEL_IMPORT_FLAGS);
+	if (!scene || !scene->mRootNode)
 	{
 		reportError("Model failed to import!", 1);
 		reportError(importer.GetErrorString(), 0);
-		return -1;
+		return 0;
+	}
+
+	std::vector<ImportedMesh> meshes;
+	importNode(scene, scene->mRootNode, aiMatrix4x4(), data, meshes);
+
+	if (meshes.empty())
+	{
+		reportError("Model has no meshes!(" + filepath + ")", 1);
+		return 0;
+	}
+
+	VertexCacheStats before, after;
+	unsigned int triangleCount = 0;
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		if (optimize)
+			optimizeMesh(data, meshes.at(i), before, after);
+		appendSubMesh(data, meshes.at(i).indices, meshes.at(i).baseVertex, meshes.at(i).vertexCount);
+		triangleCount += meshes.at(i).indices.size() / 3;
+	}
+	MeshLod fullDetail = { 0, (GLuint)meshes.size(), 0.0f };
+	data.lods.push_back(fullDetail);
+
+	if (optimize)
+	{
+		std::cout << filepath << " vertex cache: ACMR " << before.getACMR() << " -> " << after.getACMR()
+			<< ", ATVR " << before.getATVR() << " -> " << after.getATVR() << std::endl;
+	}
+
+	data.bounds = computeBounds(data.positions.empty() ? NULL : &data.positions[0], data.positions.size());
+
+	//each LOD halves the previous one, they share the vertex buffer and only add indices
+	std::vector<std::vector<unsigned int> > lodIndices(meshes.size());
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		lodIndices.at(i) = meshes.at(i).indices;
+	float lodError = 0.0f;
+	while (data.lods.size() < MAX_MESH_LODS)
+	{
+		unsigned int lodTriangles = 0;
+		float stepError = 0.0f;
+		for (unsigned int i = 0; i < meshes.size(); i++)
+		{
+			ImportedMesh &mesh = meshes.at(i);
+			std::vector<unsigned int> simplified;
+			if (!lodIndices.at(i).empty())
+			{
+				stepError = std::max(stepError, simplifyMesh(lodIndices.at(i), &data.positions[mesh.baseVertex], &data.attributes[mesh.baseVertex], mesh.vertexCount,
+					lodIndices.at(i).size() / 6 * 3, LOD_MAX_STEP_ERROR * data.bounds.radius, simplified));
+			}
+			lodIndices.at(i).swap(simplified);
+			lodTriangles += lodIndices.at(i).size() / 3;
+		}
+		if (lodTriangles == 0 || lodTriangles > LOD_MIN_REDUCTION * triangleCount)
+			break;
+
+		//errors add up since each step only knows the one before it
+		lodError += stepError;
+		MeshLod lod = { (GLuint)data.subMeshes.size(), (GLuint)meshes.size(), lodError };
+		for (unsigned int i = 0; i < meshes.size(); i++)
+		{
+			std::vector<unsigned int> indices = lodIndices.at(i);
+			if (optimize && !indices.empty())
+			{
+				std::vector<unsigned int> clusters;
+				optimizeVertexCache(indices, meshes.at(i).vertexCount, &clusters);
+				optimizeOverdraw(indices, &data.positions[meshes.at(i).baseVertex], clusters);
+			}
+			appendSubMesh(data, indices, meshes.at(i).baseVertex, meshes.at(i).vertexCount);
+		}
+		data.lods.push_back(lod);
+		triangleCount = lodTriangles;
+
+		std::cout << filepath << " LOD " << data.lods.size() - 1 << ": " << lodTriangles << " triangles, error " << lodError << std::endl;
+	}
+
+	//collision uses the same triangles as rendering, welded so shared corners are stored once
+	std::vector<unsigned int> triangles;
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		for (unsigned int j = 0; j < meshes.at(i).indices.size(); j++)
+			triangles.push_back(meshes.at(i).baseVertex + meshes.at(i).indices[j]);
 	}
-	
-	filenames.push_back(filepath);
+	if (!triangles.empty())
+		weldTriangles(&data.positions[0], &triangles[0], triangles.size(), data.colVertices, data.colIndices);
+
+	//quantize the streams that actually get uploaded
+	PositionDequant dequant = getPositionDequant(data.bounds.min, data.bounds.max);
+	data.packedPositions.reserve(data.positions.size());
+	for (unsigned int i = 0; i < data.positions.size(); i++)
+		data.packedPositions.push_back(packPosition(data.positions[i], dequant));
+	data.packedAttributes.reserve(data.attributes.size());
+	for (unsigned int i = 0; i < data.attributes.size(); i++)
+		data.packedAttributes.push_back(packAttributes(data.attributes[i]));
 
-	const aiMesh *mesh = scene->mMeshes[0];
+	return 1;
+}
+
+//give a model a slot in every list, it isn't drawable until uploaded
+AssetHandle ModelManager::reserveModel(std::string filepath)
+{
+	AssetHandle model = registry.add(filepath);
 
-	vert.reserve(mesh->mNumVertices);
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	//reused slots were already cleared by freeModel, new ones need room
+	unsigned int slotCount = registry.getSlotCount();
+	if (resident.size() < slotCount)
 	{
-		aiVector3D pos = mesh->mVertices[i];
-		vert.push_back(glm::vec3(pos.x, pos.y, pos.z));
+		positions.resize(slotCount, 0);
+		attributes.resize(slotCount, 0);
+		indices.resize(slotCount, 0);
+		subMeshes.resize(slotCount);
+		lods.resize(slotCount);
+		vaos.resize(slotCount, 0);
+		depthVaos.resize(slotCount, 0);
+		positionDequants.resize(slotCount);
+		bounds.resize(slotCount);
+		colShapes.resize(slotCount, NULL);
+		collisionMeshes.resize(slotCount, NULL);
+		resident.resize(slotCount, 0);
+		failed.resize(slotCount, 0);
+		memory.resize(slotCount, ModelMemory());
 	}
+	return model;
+}
 
-	uv.reserve(mesh->mNumVertices);
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+//delete a model's GL objects and collision data and clear its slot for reuse
+void ModelManager::freeModel(GLuint index)
+{
+	if (resident.at(index))
 	{
-		aiVector3D UVW = mesh->mTextureCoords[0][i];
-		uv.push_back(glm::vec2(UVW.x, UVW.y));
+		ResourceTracker &tracker = ResourceTracker::get();
+		const std::string &name = registry.getSlotPath(index);
+		tracker.remove(RESOURCE_VERTEX_BUFFERS, name, memory.at(index).vertexBytes);
+		tracker.remove(RESOURCE_INDEX_BUFFERS, name, memory.at(index).indexBytes);
+		tracker.remove(RESOURCE_COLLISION, name, memory.at(index).collisionBytes);
+		memory.at(index) = ModelMemory();
+
+		glDeleteVertexArrays(1, &vaos.at(index));
+		glDeleteVertexArrays(1, &depthVaos.at(index));
+		glDeleteBuffers(1, &positions.at(index));
+		glDeleteBuffers(1, &attributes.at(index));
+		glDeleteBuffers(1, &indices.at(index));
 	}
+	delete colShapes.at(index);
+	delete collisionMeshes.at(index);
+
+	positions.at(index) = 0;
+	attributes.at(index) = 0;
+	indices.at(index) = 0;
+	subMeshes.at(index).clear();
+	lods.at(index).clear();
+	vaos.at(index) = 0;
+	depthVaos.at(index) = 0;
+	positionDequants.at(index) = PositionDequant();
+	bounds.at(index) = ModelBounds();
+	colShapes.at(index) = NULL;
+	collisionMeshes.at(index) = NULL;
+	resident.at(index) = 0;
+	failed.at(index) = 0;
+}
 
-	norm.reserve(mesh->mNumVertices);
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+//CPU side of loading a model, safe to run on a worker thread
+bool ModelManager::cookModel(CookedModel *cooked)
+{
+	//use the cooked copy if it was built from this exact file, otherwise import and cook it
+	unsigned long long sourceHash = MeshCache::hashSource(cooked->filepath);
+	std::string cachePath = MeshCache::getCachePath(cooked->filepath);
+	unsigned int cookFlags = cooked->optimizeMeshes ? MESH_COOK_OPTIMIZED : 0;
+	if (cooked->cache.open(cachePath, sourceHash, MODEL_IMPORT_FLAGS, cookFlags))
+		cooked->mesh = cooked->cache.getView();
+	else
 	{
-		aiVector3D n = mesh->mNormals[i];
-		norm.push_back(glm::vec3(n.x, n.y, n.z));
+		if (!importModel(cooked->filepath, cooked->imported, cooked->optimizeMeshes))
+			return 0;
+		if (!MeshCache::write(cachePath, cooked->imported, sourceHash, MODEL_IMPORT_FLAGS, cookFlags))
+			reportError("Couldn't write mesh cache!(" + cachePath + ")", 0);
+		cooked->mesh = getMeshView(cooked->imported);
 	}
+	const MeshView &mesh = cooked->mesh;
 
-	ind.reserve(3 * mesh->mNumFaces);
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	//use the mesh as collsion mesh
+	if (cooked->useMeshAsColShape)
 	{
-		ind.push_back(mesh->mFaces[i].mIndices[0]);
-		ind.push_back(mesh->mFaces[i].mIndices[1]);
-		ind.push_back(mesh->mFaces[i].mIndices[2]);
+		if (mesh.colIndexCount < 3)
+		{
+			reportError("Model has no collision triangles!(" + cooked->filepath + ")", 0);
+			return 0;
+		}
+
+		cooked->colMesh = new CollisionMesh(mesh.colVertices, mesh.colVertexCount, mesh.colIndices, mesh.colIndexCount);
+		std::cout << cooked->filepath << " collision mesh: " << cooked->colMesh->getTriangleCount() << " triangles, "
+			<< cooked->colMesh->getSoupMemoryUsage() / 1024 << " KB as a triangle soup -> "
+			<< cooked->colMesh->getMemoryUsage() / 1024 << " KB welded" << std::endl;
+
+		//BVH quantized over the model's real extent, loaded from its own cache when the triangles match
+		cooked->colShape = cooked->colMesh->createShape(mesh.bounds, cooked->filepath + ".zbvh");
 	}
 
-	GLuint vertexbuffer;
-	glGenBuffers(1, &vertexbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, vert.size() * sizeof(glm::vec3), &vert[0], GL_STATIC_DRAW);
+	cooked->ok = 1;
+	return 1;
+}
 
-	GLuint uvbuffer;
-	glGenBuffers(1, &uvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(GL_ARRAY_BUFFER, uv.size() * sizeof(glm::vec2), &uv[0], GL_STATIC_DRAW);
+//GL side of loading a model, has to run on the GL thread
+void ModelManager::uploadModel(CookedModel *cooked)
+{
+	const MeshView &mesh = cooked->mesh;
+	GLuint index = cooked->handle.index;
 
-	GLuint normalbuffer;
-	glGenBuffers(1, &normalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glBufferData(GL_ARRAY_BUFFER, norm.size() * sizeof(glm::vec3), &norm[0], GL_STATIC_DRAW);
+	//upload straight from the mapping (or the imported data), no intermediate copies
+	GLuint positionbuffer;
+	glGenBuffers(1, &positionbuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, positionbuffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(PackedPosition), mesh.positions, GL_STATIC_DRAW);
+
+	GLuint attributebuffer;
+	glGenBuffers(1, &attributebuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, attributebuffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(PackedAttributes), mesh.attributes, GL_STATIC_DRAW);
 
 	GLuint elementbuffer;
 	glGenBuffers(1, &elementbuffer);
+
+	//VAO for the main pass, positions plus the interleaved attributes
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, ind.size() * sizeof(unsigned short), &ind[0], GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBytes, mesh.indices, GL_STATIC_DRAW);
 
-	vertices.push_back(vertexbuffer);
-	uvs.push_back(uvbuffer);
-	normals.push_back(normalbuffer);
-	indices.push_back(elementbuffer);
-	indicesSize.push_back(ind.size());
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, positionbuffer);
+	glVertexAttribPointer(
+		0,                  // attribute
+		3,                  // size
+		GL_UNSIGNED_SHORT,  // type
+		GL_TRUE,            // normalized?
+		sizeof(PackedPosition), // stride
+		(void*)0            // array buffer offset
+		);
 
-	//use the mesh as collsion mesh
-	if (useMeshAsColShape)
+	glEnableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, attributebuffer);
+	glVertexAttribPointer(
+		1,                                // attribute
+		2,                                // size
+		GL_HALF_FLOAT,                    // type
+		GL_FALSE,                         // normalized?
+		sizeof(PackedAttributes),         // stride
+		(void*)offsetof(PackedAttributes, uv) // array buffer offset
+		);
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(
+		2,                                // attribute
+		2,                                // size
+		GL_SHORT,                         // type
+		GL_TRUE,                          // normalized?
+		sizeof(PackedAttributes),         // stride
+		(void*)offsetof(PackedAttributes, normal) // array buffer offset
+		);
+
+	//VAO for the depth pass, only fetches positions
+	GLuint depthVao;
+	glGenVertexArrays(1, &depthVao);
+	glBindVertexArray(depthVao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, positionbuffer);
+	glVertexAttribPointer(
+		0,                  // attribute
+		3,                  // size
+		GL_UNSIGNED_SHORT,  // type
+		GL_TRUE,            // normalized?
+		sizeof(PackedPosition), // stride
+		(void*)0            // array buffer offset
+		);
+
+	glBindVertexArray(0);
+
+	positions.at(index) = positionbuffer;
+	attributes.at(index) = attributebuffer;
+	indices.at(index) = elementbuffer;
+	subMeshes.at(index).assign(mesh.subMeshes, mesh.subMeshes + mesh.subMeshCount);
+	lods.at(index).assign(mesh.lods, mesh.lods + mesh.lodCount);
+	vaos.at(index) = vao;
+	depthVaos.at(index) = depthVao;
+	positionDequants.at(index) = getPositionDequant(mesh.bounds.min, mesh.bounds.max);
+	bounds.at(index) = mesh.bounds;
+
+	//the model manager owns the collision data from here on
+	colShapes.at(index) = cooked->colShape;
+	collisionMeshes.at(index) = cooked->colMesh;
+	cooked->colShape = NULL;
+	cooked->colMesh = NULL;
+
+	ModelMemory &used = memory.at(index);
+	used.vertexBytes = mesh.vertexCount * (sizeof(PackedPosition) + sizeof(PackedAttributes));
+	used.indexBytes = mesh.indexBytes;
+	used.collisionBytes = 0;
+	if (collisionMeshes.at(index) != NULL && colShapes.at(index) != NULL)
+		used.collisionBytes = collisionMeshes.at(index)->getMemoryUsage() + collisionMeshes.at(index)->getShapeMemoryUsage((btBvhTriangleMeshShape*)colShapes.at(index));
+	ResourceTracker &tracker = ResourceTracker::get();
+	tracker.add(RESOURCE_VERTEX_BUFFERS, cooked->filepath, used.vertexBytes);
+	tracker.add(RESOURCE_INDEX_BUFFERS, cooked->filepath, used.indexBytes);
+	tracker.add(RESOURCE_COLLISION, cooked->filepath, used.collisionBytes);
+
+	resident.at(index) = 1;
+}
+
+//load new model into opengl
+AssetHandle ModelManager::newModel(std::string filepath, bool useMeshAsColShape)
+{
+	AssetHandle loaded = registry.acquire(filepath);
+	if (loaded.isValid())
+		return loaded;
+
+	CookedModel cooked(filepath, useMeshAsColShape, optimizeMeshes);
+	if (!cookModel(&cooked))
+		return AssetHandle();
+
+	cooked.handle = reserveModel(filepath);
+	uploadModel(&cooked);
+	return cooked.handle;
+}
+
+//start loading a model on a worker thread, the returned model draws once processUploads has uploaded it
+AssetHandle ModelManager::loadModelAsync(std::string filepath, bool useMeshAsColShape)
+{
+	AssetHandle loaded = registry.acquire(filepath);
+	if (loaded.isValid())
+		return loaded;
+
+	if (workers == NULL)
+		return newModel(filepath, useMeshAsColShape);
+
+	AssetHandle model = reserveModel(filepath);
+	CookedModel *cooked = new CookedModel(filepath, useMeshAsColShape, optimizeMeshes);
+	cooked->handle = model;
+	workers->addJob([this, cooked]()
 	{
-		btTriangleMesh* trigMesh = new btTriangleMesh;
-		int totalVerts = mesh->mNumVertices;
+		cookModel(cooked);
+		std::lock_guard<std::mutex> lock(uploadMutex);
+		uploadQueue.push_back(cooked);
+	});
+	return model;
+}
 
-		for (int i = 0; i < totalVerts;)
+//upload every model the workers have finished, call once a frame on the GL thread
+void ModelManager::processUploads()
+{
+	std::vector<CookedModel*> ready;
+	{
+		std::lock_guard<std::mutex> lock(uploadMutex);
+		ready.swap(uploadQueue);
+	}
+
+	for (unsigned int i = 0; i < ready.size(); i++)
+	{
+		CookedModel *cooked = ready.at(i);
+		//released while it was loading, the slot may belong to another model by now
+		if (registry.isLive(cooked->handle))
 		{
-			//glm::vec3 vecA = vert.at(ind.at(i++));
-			aiVector3D vecA = mesh->mVertices[i++];
-			btVector3 vertA(vecA.x, vecA.y, vecA.z);
-			//glm::vec3 vecB = vert.at(ind.at(i++));
-			aiVector3D vecB = mesh->mVertices[i++];
-			btVector3 vertB(vecB.x, vecB.y, vecB.z);
-			//glm::vec3 vecC = vert.at(ind.at(i++));
-			aiVector3D vecC = mesh->mVertices[i++];
-			btVector3 vertC(vecC.x, vecC.y, vecC.z);
-			trigMesh->addTriangle(vertA, vertB, vertC, 1);
-
-			//std::cout << vecA.x << " " << vecA.y << " " << vecA.z << " : " << vecB.x << " " << vecB.y << " " << vecB.z << " : " << vecC.x << " " << vecC.y << " " << vecC.z << std::endl;
+			if (cooked->ok)
+				uploadModel(cooked);
+			else
+			{
+				//nothing will ever be uploaded to the slot, users stop waiting for it
+				failed.at(cooked->handle.index) = 1;
+				reportError("Model failed to load!(" + cooked->filepath + ")", 0);
+			}
 		}
+		delete cooked;
+	}
+}
 
-		btTriangleIndexVertexArray* indexArray = new btTriangleIndexVertexArray(*trigMesh);
+void ModelManager::releaseModel(AssetHandle model)
+{
+	if (registry.release(model))
+		freeModel(model.index);
+}
 
-		btVector3 aabbMin(-1000, -1000, -1000), aabbMax(1000, 1000, 1000);
+//coarsest LOD whose error projects to less than the allowed number of pixels
+GLuint ModelManager::selectLod(GLuint index, const glm::mat4 &modelMatrix, float scale)
+{
+	const std::vector<MeshLod> &chain = lods.at(index);
+	if (chain.size() < 2)
+		return 0;
+
+	//distance to the nearest point of the bounding sphere, orthographic projections don't shrink with it
+	const ModelBounds &bound = bounds.at(index);
+	float depth = 1.0f;
+	if (passProj[2][3] != 0.0f)
+	{
+		glm::vec4 center = passView * (modelMatrix * glm::vec4(bound.center, 1.0f));
+		depth = -center.z - bound.radius * scale;
+		if (depth <= 0.0f)
+			return 0;
+	}
+
+	float pixelsPerUnit = passProj[1][1] * 0.5f * lodScreenHeight * scale / depth;
+	float allowed = passDepthOnly ? lodPixelError * shadowLodScale : lodPixelError;
+	GLuint lod = 0;
+	while (lod + 1 < chain.size() && chain[lod + 1].error * pixelsPerUnit <= allowed)
+		lod++;
+	return lod;
+}
 
-		btCollisionShape* meshCol = new btBvhTriangleMeshShape(indexArray, 1, aabbMin, aabbMax);
-		colShapes.push_back(meshCol);
-		vertexArrays.push_back(indexArray);
-		triangleMeshes.push_back(trigMesh);
+float ModelManager::getScreenSize(AssetHandle model, const glm::mat4 &modelMatrix, float maxScale, const glm::mat4 &proj, const glm::mat4 &view)
+{
+	if (!isResident(model))
+		return 0.0f;
+	const ModelBounds &bound = bounds.at(model.index);
+	float radius = bound.radius * maxScale;
+
+	//same measure as the LODs, from the nearest point of the sphere
+	float depth = 1.0f;
+	if (proj[2][3] != 0.0f)
+	{
+		glm::vec4 center = view * (modelMatrix * glm::vec4(bound.center, 1.0f));
+		depth = -center.z - radius;
+		if (depth <= 0.0f)
+			return lodScreenHeight;
 	}
+	return proj[1][1] * 0.5f * lodScreenHeight * 2.0f * radius / depth;
+}
 
-	return indices.size() - 1;
+void ModelManager::beginDraw(glm::mat4* projMat, glm::mat4* viewMat, bool drawOnlyVerts, GLuint *matID)
+{
+	boundArray = 0;
+	passProj = *projMat;
+	passView = *viewMat;
+	passViewProj = passProj * passView;
+	passDepthOnly = drawOnlyVerts;
+	passMatID = matID;
+	if (drawOnlyVerts && matID != NULL)
+		depthViewProj = passViewProj;
 }
 
 //draw the model
-bool ModelManager::draw(GLuint index, GLuint texIndex, glm::vec3 pos, glm::quat rot, glm::vec3 scale, glm::mat4* projMat, glm::mat4* viewMat, bool drawOnlyVerts, GLuint *matID)
+bool ModelManager::draw(AssetHandle model, GLuint texArray, GLuint layer, const glm::mat4 &modelMatrix, float maxScale)
 {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texIndex);
-	glUniform1i(texID, 0);
+	//still loading or released, nothing to draw
+	if (!isResident(model))
+		return 1;
+	GLuint index = model.index;
 
-	glm::mat4 RotationMatrix = mat4_cast(rot);
-	glm::mat4 TranslationMatrix = translate(mat4(), pos);
-	glm::mat4 ScalingMatrix = glm::scale(mat4(), scale);
-	glm::mat4 ModelMatrix = TranslationMatrix * RotationMatrix * ScalingMatrix;
+	//textures of the same format and size share an array, only the layer changes between them
+	if (!passDepthOnly)
+	{
+		if (texArray != boundArray)
+		{
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texArray);
+			glUniform1i(texID, 0);
+			boundArray = texArray;
+		}
+		glUniform1i(LayerID, layer);
+	}
 
-	glm::mat4 MVP = *projMat * *viewMat * ModelMatrix;
+	glm::mat4 MVP = passViewProj * modelMatrix;
 	// Send our transformation to the currently bound shader, 
 	// in the "MVP" uniform
-	if (matID == NULL)
+	if (passMatID == NULL)
 	{
 		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
+		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &modelMatrix[0][0]);
 	}
-	else if (drawOnlyVerts)
+	else if (passDepthOnly)
 	{
-		glm::mat4 depthMVP = *projMat * *viewMat * ModelMatrix;
-		glUniformMatrix4fv(*matID, 1, GL_FALSE, &depthMVP[0][0]);
-		depthMVPs.push_back(depthMVP);
+		glUniformMatrix4fv(*passMatID, 1, GL_FALSE, &MVP[0][0]);
 	}
-	else if (matID != NULL && !drawOnlyVerts)
+	else
 	{
-		glm::mat4 depthMVP = depthMVPs.at(index);
 		glm::mat4 biasMatrix(
 			0.5, 0.0, 0.0, 0.0,
 			0.0, 0.5, 0.0, 0.0,
@@ -166,61 +614,39 @@ bool ModelManager::draw(GLuint index, GLuint texIndex, glm::vec3 pos, glm::quat
 			0.5, 0.5, 0.5, 1.0
 			);
 
-		glm::mat4 depthBiasMVP = biasMatrix * depthMVP;
+		glm::mat4 depthBiasMVP = biasMatrix * depthViewProj * modelMatrix;
 
 		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glUniformMatrix4fv(*matID, 1, GL_FALSE, &depthBiasMVP[0][0]);
+		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &modelMatrix[0][0]);
+		glUniformMatrix4fv(*passMatID, 1, GL_FALSE, &depthBiasMVP[0][0]);
 	}
 
-	GLuint vertexbuffer = vertices.at(index);
-	GLuint uvbuffer = uvs.at(index);
-	GLuint normalbuffer = normals.at(index);
-	GLuint elementbuffer = indices.at(index);
-
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glVertexAttribPointer(
-		0,                  // attribute
-		3,                  // size
-		GL_FLOAT,           // type
-		GL_FALSE,           // normalized?
-		0,                  // stride
-		(void*)0            // array buffer offset
-		);
-	if (!drawOnlyVerts)
-	{
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-		glVertexAttribPointer(
-			1,                                // attribute
-			2,                                // size
-			GL_FLOAT,                         // type
-			GL_FALSE,                         // normalized?
-			0,                                // stride
-			(void*)0                          // array buffer offset
-			);
+	//everything about the vertex layout is already in the VAO, positions just need their range
+	const PositionDequant &dequant = positionDequants.at(index);
+	if (passDepthOnly)
+	{
+		glUniform3fv(DepthDequantID, 2, &dequant.offset[0]);
+		glBindVertexArray(depthVaos.at(index));
+	}
+	else
+	{
+		glUniform3fv(DequantID, 2, &dequant.offset[0]);
+		glBindVertexArray(vaos.at(index));
+	}
 
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-		glVertexAttribPointer(
-			2,                                // attribute
-			3,                                // size
-			GL_FLOAT,                         // type
-			GL_FALSE,                         // normalized?
-			0,                                // stride
-			(void*)0                          // array buffer offset
+	// Draw the triangles ! One draw per submesh of the LOD, each with its own index width
+	const MeshLod &lod = lods.at(index).at(selectLod(index, modelMatrix, maxScale));
+	const std::vector<SubMesh> &subs = subMeshes.at(index);
+	for (unsigned int i = lod.firstSubMesh; i < lod.firstSubMesh + lod.subMeshCount; i++)
+	{
+		glDrawElementsBaseVertex(
+			GL_TRIANGLES,                     // mode
+			subs[i].indexCount,               // count
+			subs[i].indexType,                // type
+			(void*)(size_t)subs[i].indexOffset, // element array buffer offset
+			subs[i].baseVertex                // added to every index
 			);
 	}
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-
-	// Draw the triangles !
-	glDrawElements(
-		GL_TRIANGLES,      // mode
-		indicesSize.at(index),    // count
-		GL_UNSIGNED_SHORT,   // type
-		(void*)0           // element array buffer offset
-		);
 
 	return 1;
 }
@@ -228,15 +654,11 @@ bool ModelManager::draw(GLuint index, GLuint texIndex, glm::vec3 pos, glm::quat
 //delete everything
 ModelManager::~ModelManager()
 {
-	for (unsigned int i = 0; i > indicesSize.size(); i++)
-	{
-		glDeleteBuffers(1, &vertices.at(i));
-		glDeleteBuffers(1, &uvs.at(i));
-		glDeleteBuffers(1, &normals.at(i));
-		glDeleteBuffers(1, &indices.at(i));
-	}
-	for (unsigned int i = 0; i < vertexArrays.size(); i++)
-		delete vertexArrays.at(i);
-	for (unsigned int i = 0; i < triangleMeshes.size(); i++)
-		delete triangleMeshes.at(i);
+	//the workers are already stopped, anything they finished is never getting uploaded
+	for (unsigned int i = 0; i < uploadQueue.size(); i++)
+		delete uploadQueue.at(i);
+
+	//free slots are already empty
+	for (unsigned int i = 0; i < resident.size(); i++)
+		freeModel(i);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <mutex>
 
 //Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
 #include <GL/glew.h>
@@ -22,49 +23,190 @@
 #include <btBulletDynamicsCommon.h>
 
 #include "textureManager.h"
+#include "assetRegistry.h"
+#include "meshCache.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "threadPool.h"
+#include "collisionMesh.h"
+#include "resourceTracker.h"
 
 #include "error.h"
 
+//Bytes a model reported to the resource tracker, so freeing it takes back the same amounts
+struct ModelMemory
+{
+	size_t vertexBytes;
+	size_t indexBytes;
+	size_t collisionBytes;
+};
+
+//Everything a worker produces for a model, handed to the GL thread for upload
+struct CookedModel
+{
+	AssetHandle handle; //model slot it belongs to
+	std::string filepath;
+	bool useMeshAsColShape;
+	bool optimizeMeshes; //the manager's setting when the load started, workers never read the manager's
+	bool ok; //did it load
+	MeshCache cache; //mapping the view points into on a cache hit
+	MeshData imported; //data the view points into on a cache miss
+	MeshView mesh; //what gets uploaded
+	btCollisionShape *colShape; //collision data, owned until the upload hands it over
+	CollisionMesh *colMesh;
+
+	CookedModel(std::string file, bool meshCol, bool optimize)
+	{
+		filepath = file;
+		useMeshAsColShape = meshCol;
+		optimizeMeshes = optimize;
+		ok = 0;
+		mesh = MeshView();
+		colShape = NULL;
+		colMesh = NULL;
+	}
+	~CookedModel()
+	{
+		delete colShape;
+		delete colMesh;
+	}
+};
+
 class ModelManager
 {
 	std::vector<GLuint> indices;
-	std::vector<GLuint> vertices;
-	std::vector<GLuint> uvs;
-	std::vector<GLuint> normals;
-	std::vector<GLuint> indicesSize;
+	std::vector<GLuint> positions; //position only vertex buffers
+	std::vector<GLuint> attributes; //interleaved uv/normal vertex buffers
+	std::vector<std::vector<SubMesh> > subMeshes; //draw ranges inside each model's buffers, for every LOD
+	std::vector<std::vector<MeshLod> > lods; //which submeshes make up each LOD of each model
+	std::vector<GLuint> vaos; //VAO per model for the main pass
+	std::vector<GLuint> depthVaos; //VAO per model that only reads positions, for the depth pass
+	std::vector<PositionDequant> positionDequants; //turns each model's quantized positions back into model space
+	std::vector<ModelBounds> bounds; //model space AABB and bounding sphere of each model
 
-	std::vector<std::string> filenames;
+	AssetRegistry registry; //path lookup and reference counts, its slots index the lists here
 
 	std::vector<btCollisionShape*> colShapes;
-	std::vector<btTriangleIndexVertexArray*> vertexArrays;
-	std::vector<btTriangleMesh*> triangleMeshes;
+	std::vector<CollisionMesh*> collisionMeshes; //welded triangles the mesh shapes read from
+	std::vector<bool> resident; //has the model been uploaded
+	std::vector<bool> failed; //did the async load fail, the slot stays empty until it's released
+	std::vector<ModelMemory> memory; //what each uploaded model counts in the resource tracker
+
+	ThreadPool *workers; //runs the CPU side of async loads
+	std::mutex uploadMutex; //guards uploadQueue
+	std::vector<CookedModel*> uploadQueue; //models the workers finished, waiting for the GL thread
 
 	GLuint texID;
+	GLuint LayerID; //texture array layer uniform in the main program
+	GLuint boundArray; //texture array bound by the last draw, 0 at the start of a pass
 	GLuint MatrixID;
 	GLuint ViewMatrixID;
 	GLuint ModelMatrixID;
-
-	std::vector<glm::mat4> depthMVPs;
-
-	GLuint checkIfModelExists(std::string filepath);
+	GLuint DequantID; //position dequantization uniform in the main program
+	GLuint DepthDequantID; //position dequantization uniform in the depth program
+
+	//this pass's matrices, set by beginDraw so draws only multiply in their model matrix
+	glm::mat4 passProj;
+	glm::mat4 passView;
+	glm::mat4 passViewProj;
+	bool passDepthOnly;
+	GLuint *passMatID;
+	glm::mat4 depthViewProj; //light's view projection from the last depth pass, for the shadow lookup
+
+	bool optimizeMeshes; //reorder imported meshes for the vertex cache, overdraw and vertex fetch
+
+	float lodScreenHeight; //height in pixels of the target LODs are picked for
+	float lodPixelError; //largest error on screen a LOD may have, in pixels
+	float shadowLodScale; //how much more error the depth pass accepts
+
+	bool importModel(std::string filepath, MeshData &data, bool optimize);
+	AssetHandle reserveModel(std::string filepath);
+	bool cookModel(CookedModel *cooked);
+	void uploadModel(CookedModel *cooked);
+	void freeModel(GLuint index);
+	GLuint selectLod(GLuint index, const glm::mat4 &modelMatrix, float scale);
+	void setLodDefaults()
+	{
+		lodScreenHeight = 768.0f;
+		lodPixelError = 1.0f;
+		shadowLodScale = 4.0f;
+	}
 public:
 	ModelManager()
-	{};
-	ModelManager(GLuint TextureID, GLuint matID, GLuint VMID, GLuint MMID)
 	{
+		optimizeMeshes = 1;
+		workers = NULL;
+		boundArray = 0;
+		passDepthOnly = 0;
+		passMatID = NULL;
+		setLodDefaults();
+	};
+	ModelManager(GLuint TextureID, GLuint layerID, GLuint matID, GLuint VMID, GLuint MMID, GLuint dequantID, GLuint depthDequantID, ThreadPool *pool)
+	{
+		optimizeMeshes = 1;
+		workers = pool;
 		texID = TextureID;
+		LayerID = layerID;
+		boundArray = 0;
+		passDepthOnly = 0;
+		passMatID = NULL;
 		MatrixID = matID;
 		ViewMatrixID = VMID;
 		ModelMatrixID = MMID;
+		DequantID = dequantID;
+		DepthDequantID = depthDequantID;
+		setLodDefaults();
 	};
 	~ModelManager();
 
-	GLuint newModel(std::string filepath, bool useMeshAsColShape);
-	bool draw(GLuint index, GLuint texIndex, glm::vec3 pos, glm::quat rot, glm::vec3 scale, glm::mat4* projMat, glm::mat4* viewMat, bool drawOnlyVerts, GLuint *matID);
-	btCollisionShape* getColShape(GLuint index)
-	{ return colShapes.at(index); }
-	void clearDepthMVP()
-	{ depthMVPs.clear(); }
+	//load a model or add a reference to the already loaded one, invalid handle if it fails
+	AssetHandle newModel(std::string filepath, bool useMeshAsColShape);
+	AssetHandle loadModelAsync(std::string filepath, bool useMeshAsColShape);
+	void processUploads();
+	//add a reference to a loaded model, for handing one handle to many users
+	void addModelRef(AssetHandle model)
+	{ registry.addRef(model); }
+	//drop a reference, the model's buffers and collision data are deleted with the last one
+	void releaseModel(AssetHandle model);
+	//is the model uploaded and drawable
+	bool isResident(AssetHandle model)
+	{ return registry.isLive(model) && resident[model.index]; }
+	//did the model's async load fail, it never becomes resident
+	bool isFailed(AssetHandle model)
+	{ return registry.isLive(model) && failed[model.index]; }
+	//is the model still loading, neither resident nor failed
+	bool isPending(AssetHandle model)
+	{ return registry.isLive(model) && !resident[model.index] && !failed[model.index]; }
+	//diameter in pixels of the model's bounding sphere on screen, what texture streaming sizes mips by
+	float getScreenSize(AssetHandle model, const glm::mat4 &modelMatrix, float maxScale, const glm::mat4 &proj, const glm::mat4 &view);
+	//start a pass, the view projection is multiplied once here instead of every draw
+	//a depth pass with matID keeps its view projection for the next pass's shadow lookup
+	//also forgets which texture array is bound, since anything may have bound another
+	void beginDraw(glm::mat4* projMat, glm::mat4* viewMat, bool drawOnlyVerts, GLuint *matID);
+	//draw with a layer of a texture array in the current pass, the array is only bound if the last draw used another one
+	//maxScale is the model matrix's largest scale, for picking the LOD
+	bool draw(AssetHandle model, GLuint texArray, GLuint layer, const glm::mat4 &modelMatrix, float maxScale);
+	//get the model's collision shape, owned by the model manager
+	btCollisionShape* getColShape(AssetHandle model)
+	{ return registry.isLive(model) ? colShapes[model.index] : NULL; }
+	//get the welded collision triangles of a model loaded with useMeshAsColShape, NULL otherwise
+	CollisionMesh* getCollisionMesh(AssetHandle model)
+	{ return registry.isLive(model) ? collisionMeshes[model.index] : NULL; }
+	//get a model's model space bounds, only valid once it is resident
+	const ModelBounds& getBounds(AssetHandle model)
+	{ return bounds.at(model.index); }
+	//turn the import time mesh optimization on or off, only affects models imported afterwards
+	void setOptimizeMeshes(bool optimize)
+	{ optimizeMeshes = optimize; }
+	//pick LODs so their error stays under pixelError pixels on a screenHeight pixel tall target
+	void setLodTarget(float screenHeight, float pixelError)
+	{
+		lodScreenHeight = screenHeight;
+		lodPixelError = pixelError;
+	}
+	//how many times more error the depth pass accepts, it only needs the silhouette
+	void setShadowLodScale(float scale)
+	{ shadowLodScale = scale; }
 };
 
 #endif
\ No newline at end of file
@@ -1,3 +1,10 @@
+#include <BulletCollision/CollisionDispatch/btInternalEdgeUtility.h>
+
 #include "physics.h"
 
-//Nothing here yet
\ No newline at end of file
+bool adjustMeshContact(btManifoldPoint& cp, const btCollisionObjectWrapper* colObj0Wrap, int partId0, int index0, const btCollisionObjectWrapper* colObj1Wrap, int partId1, int index1)
+{
+	//does nothing for shapes without an info map
+	btAdjustInternalEdgeContacts(cp, colObj1Wrap, colObj0Wrap, partId1, index1);
+	return true;
+}
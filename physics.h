@@ -3,6 +3,9 @@
 
 #include <btBulletDynamicsCommon.h>
 
+//Contact added callback, smooths contacts on the internal edges of meshes with a triangle info map
+bool adjustMeshContact(btManifoldPoint& cp, const btCollisionObjectWrapper* colObj0Wrap, int partId0, int index0, const btCollisionObjectWrapper* colObj1Wrap, int partId1, int index1);
+
 class PhysicsManager
 {
 	btBroadphaseInterface* broadphase;
@@ -19,6 +22,8 @@ public:
 		solver = new btSequentialImpulseConstraintSolver;
 		dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
 		dynamicsWorld->setGravity(btVector3(0, -9.8f, 0));
+		//only called for bodies with CF_CUSTOM_MATERIAL_CALLBACK
+		gContactAddedCallback = adjustMeshContact;
 	}
 	~PhysicsManager()
 	{
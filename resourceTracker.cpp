@@ -0,0 +1,181 @@
+#include <fstream>
+#include <string.h>
+
+#include "resourceTracker.h"
+#include "error.h"
+
+ResourceTracker::ResourceTracker()
+{
+	memset(categories, 0, sizeof(categories));
+	gpu.bytes = gpu.highWater = 0;
+	cpu.bytes = cpu.highWater = 0;
+}
+
+ResourceTracker& ResourceTracker::get()
+{
+	static ResourceTracker tracker;
+	return tracker;
+}
+
+const char* ResourceTracker::getCategoryName(ResourceCategory category)
+{
+	switch (category)
+	{
+	case RESOURCE_VERTEX_BUFFERS:
+		return "vertexBuffers";
+	case RESOURCE_INDEX_BUFFERS:
+		return "indexBuffers";
+	case RESOURCE_TEXTURES:
+		return "textures";
+	case RESOURCE_TEXTURE_SLACK:
+		return "textureSlack";
+	case RESOURCE_RENDER_TARGETS:
+		return "renderTargets";
+	case RESOURCE_COLLISION:
+		return "collision";
+	case RESOURCE_PHYSICS_OBJECTS:
+		return "physicsObjects";
+	case RESOURCE_MAPPED_FILES:
+		return "mappedFiles";
+	default:
+		return "unknown";
+	}
+}
+
+//apply a change to a usage and move its high-water mark
+static void changeUsage(ResourceUsage &usage, size_t added, size_t removed)
+{
+	usage.bytes = usage.bytes + added - removed;
+	if (usage.bytes > usage.highWater)
+		usage.highWater = usage.bytes;
+}
+
+void ResourceTracker::change(ResourceCategory category, std::string asset, size_t added, size_t removed)
+{
+	std::lock_guard<std::mutex> lock(trackerMutex);
+	std::map<std::string, AssetResources>::iterator it = assets.find(asset);
+	if (it == assets.end())
+	{
+		AssetResources empty;
+		memset(&empty, 0, sizeof(empty));
+		it = assets.insert(std::make_pair(asset, empty)).first;
+	}
+
+	//freeing more than was counted is a bookkeeping bug, clamp so the totals stay sane
+	size_t &bytes = it->second.bytes[category];
+	if (removed > bytes + added)
+	{
+		reportError("Freed more " + std::string(getCategoryName(category)) + " than was allocated!(" + asset + ")", 0);
+		removed = bytes + added;
+	}
+	bytes = bytes + added - removed;
+
+	changeUsage(categories[category], added, removed);
+	changeUsage(isGpu(category) ? gpu : cpu, added, removed);
+
+	for (int i = 0; i < RESOURCE_CATEGORY_COUNT; i++)
+	{
+		if (it->second.bytes[i] != 0)
+			return;
+	}
+	assets.erase(it);
+}
+
+ResourceUsage ResourceTracker::getUsage(ResourceCategory category)
+{
+	std::lock_guard<std::mutex> lock(trackerMutex);
+	return categories[category];
+}
+
+ResourceUsage ResourceTracker::getGpuUsage()
+{
+	std::lock_guard<std::mutex> lock(trackerMutex);
+	return gpu;
+}
+
+ResourceUsage ResourceTracker::getCpuUsage()
+{
+	std::lock_guard<std::mutex> lock(trackerMutex);
+	return cpu;
+}
+
+size_t ResourceTracker::getAssetBytes(std::string asset, ResourceCategory category)
+{
+	std::lock_guard<std::mutex> lock(trackerMutex);
+	std::map<std::string, AssetResources>::const_iterator it = assets.find(asset);
+	return it == assets.end() ? 0 : it->second.bytes[category];
+}
+
+//quote a string for JSON, file names may have backslashes
+static std::string jsonString(const std::string &str)
+{
+	std::string out = "\"";
+	for (unsigned int i = 0; i < str.size(); i++)
+	{
+		char c = str[i];
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if ((unsigned char)c < 0x20)
+			out += ' ';
+		else
+			out += c;
+	}
+	return out + "\"";
+}
+
+static void writeUsage(std::ofstream &out, const ResourceUsage &usage)
+{
+	out << "{ \"bytes\": " << usage.bytes << ", \"highWater\": " << usage.highWater << " }";
+}
+
+bool ResourceTracker::writeJson(std::string filepath)
+{
+	std::ofstream out(filepath.c_str(), std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+		return 0;
+
+	std::lock_guard<std::mutex> lock(trackerMutex);
+	out << "{\n\t\"gpu\": ";
+	writeUsage(out, gpu);
+	out << ",\n\t\"cpu\": ";
+	writeUsage(out, cpu);
+	out << ",\n\t\"categories\": {\n";
+	for (int i = 0; i < RESOURCE_CATEGORY_COUNT; i++)
+	{
+		out << "\t\t\"" << getCategoryName((ResourceCategory)i) << "\": ";
+		writeUsage(out, categories[i]);
+		out << (i + 1 < RESOURCE_CATEGORY_COUNT ? ",\n" : "\n");
+	}
+	out << "\t},\n\t\"assets\": [\n";
+
+	std::map<std::string, AssetResources>::const_iterator it = assets.begin();
+	for (; it != assets.end(); ++it)
+	{
+		out << "\t\t{ \"name\": " << jsonString(it->first);
+		for (int i = 0; i < RESOURCE_CATEGORY_COUNT; i++)
+		{
+			if (it->second.bytes[i] != 0)
+				out << ", \"" << getCategoryName((ResourceCategory)i) << "\": " << it->second.bytes[i];
+		}
+		std::map<std::string, AssetResources>::const_iterator next = it;
+		out << (++next != assets.end() ? " },\n" : " }\n");
+	}
+	out << "\t]\n}\n";
+	return out.good();
+}
+
+bool ResourceTracker::reportLeaks()
+{
+	std::lock_guard<std::mutex> lock(trackerMutex);
+	std::map<std::string, AssetResources>::const_iterator it = assets.begin();
+	for (; it != assets.end(); ++it)
+	{
+		for (int i = 0; i < RESOURCE_CATEGORY_COUNT; i++)
+		{
+			if (it->second.bytes[i] != 0)
+				reportError("Leaked " + std::to_string((unsigned long long)it->second.bytes[i]) + " bytes of " +
+					getCategoryName((ResourceCategory)i) + "!(" + it->first + ")", 0);
+		}
+	}
+	return assets.empty();
+}
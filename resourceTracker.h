@@ -0,0 +1,75 @@
+#ifndef Z_RESOURCES
+#define Z_RESOURCES
+
+#include <string>
+#include <map>
+#include <mutex>
+
+//What kind of memory a resource uses, the GPU ones come first
+enum ResourceCategory
+{
+	RESOURCE_VERTEX_BUFFERS, //VBOs
+	RESOURCE_INDEX_BUFFERS, //IBOs
+	RESOURCE_TEXTURES, //texture layers in use
+	RESOURCE_TEXTURE_SLACK, //allocated texture array layers nothing uses yet
+	RESOURCE_RENDER_TARGETS, //framebuffer attachments
+	RESOURCE_COLLISION, //collision triangles, BVHs and edge info, CPU side
+	RESOURCE_PHYSICS_OBJECTS, //rigid bodies, motion states and shapes entities were given
+	RESOURCE_MAPPED_FILES, //cache files kept mapped, CPU address space
+	RESOURCE_CATEGORY_COUNT
+};
+
+//Bytes used and the most ever used at once
+struct ResourceUsage
+{
+	size_t bytes;
+	size_t highWater;
+};
+
+//Bytes one asset uses in every category
+struct AssetResources
+{
+	size_t bytes[RESOURCE_CATEGORY_COUNT];
+};
+
+//Counts the bytes every asset uses by category, for sizing budgets and finding leaks
+//managers add what they allocate and remove what they free, under the asset's file name
+class ResourceTracker
+{
+	std::mutex trackerMutex; //models cook on worker threads
+	std::map<std::string, AssetResources> assets; //keyed by file name
+	ResourceUsage categories[RESOURCE_CATEGORY_COUNT];
+	ResourceUsage gpu; //every GPU category
+	ResourceUsage cpu; //every CPU category
+
+	ResourceTracker();
+	void change(ResourceCategory category, std::string asset, size_t added, size_t removed);
+public:
+	//the tracker every manager reports to
+	static ResourceTracker& get();
+
+	static bool isGpu(ResourceCategory category)
+	{ return category <= RESOURCE_RENDER_TARGETS; }
+	static const char* getCategoryName(ResourceCategory category);
+
+	//count bytes an asset allocated
+	void add(ResourceCategory category, std::string asset, size_t bytes)
+	{ change(category, asset, bytes, 0); }
+	//count bytes an asset freed, the asset is forgotten once it uses nothing
+	void remove(ResourceCategory category, std::string asset, size_t bytes)
+	{ change(category, asset, 0, bytes); }
+
+	ResourceUsage getUsage(ResourceCategory category);
+	ResourceUsage getGpuUsage();
+	ResourceUsage getCpuUsage();
+	//bytes one asset uses in a category
+	size_t getAssetBytes(std::string asset, ResourceCategory category);
+
+	//write the totals, high-water marks and every asset's bytes as JSON
+	bool writeJson(std::string filepath);
+	//report every asset that still uses memory, call once everything should be freed
+	//returns false if there were any
+	bool reportLeaks();
+};
+
+#endif
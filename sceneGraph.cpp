@@ -0,0 +1,214 @@
+#include "sceneGraph.h"
+
+SceneGraph::SceneNode& SceneGraph::getNode(unsigned int entity)
+{
+	if (nodes.size() <= entity)
+	{
+		SceneNode root = { NO_PARENT, 0, 0, 0 };
+		nodes.resize(entity + 1, root);
+		changed.resize(entity + 1, 0);
+	}
+	return nodes[entity];
+}
+
+void SceneGraph::addToLevel(unsigned int entity)
+{
+	SceneNode &node = nodes[entity];
+	if (node.depth == 0)
+		return;
+	if (levels.size() <= node.depth)
+		levels.resize(node.depth + 1);
+	SceneLevel &level = levels[node.depth];
+	node.levelIndex = level.entities.size();
+	level.entities.push_back(entity);
+	level.parents.push_back(node.parent);
+}
+
+void SceneGraph::removeFromLevel(unsigned int entity)
+{
+	SceneNode &node = nodes[entity];
+	if (node.depth == 0)
+		return;
+	//swap the last entity of the level into its place
+	SceneLevel &level = levels[node.depth];
+	unsigned int last = level.entities.back();
+	level.entities[node.levelIndex] = last;
+	level.parents[node.levelIndex] = level.parents.back();
+	nodes[last].levelIndex = node.levelIndex;
+	level.entities.pop_back();
+	level.parents.pop_back();
+	while (levels.size() > 1 && levels.back().entities.empty())
+		levels.pop_back();
+}
+
+//give root a new parent and shift its whole subtree to the depths under it
+void SceneGraph::moveSubtree(unsigned int root, unsigned int parent)
+{
+	//find the subtree level by level, parents come before their children
+	std::vector<unsigned int> subtree(1, root);
+	if (nodes[root].childCount > 0)
+	{
+		std::vector<unsigned char> inSubtree(nodes.size(), 0);
+		inSubtree[root] = 1;
+		for (unsigned int d = nodes[root].depth + 1; d < levels.size(); d++)
+		{
+			const SceneLevel &level = levels[d];
+			for (unsigned int i = 0; i < level.entities.size(); i++)
+			{
+				if (inSubtree[level.parents[i]])
+				{
+					inSubtree[level.entities[i]] = 1;
+					subtree.push_back(level.entities[i]);
+				}
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < subtree.size(); i++)
+		removeFromLevel(subtree[i]);
+
+	if (nodes[root].parent != NO_PARENT)
+		nodes[nodes[root].parent].childCount--;
+	nodes[root].parent = parent;
+	nodes[root].depth = 0;
+	if (parent != NO_PARENT)
+	{
+		nodes[parent].childCount++;
+		nodes[root].depth = nodes[parent].depth + 1;
+	}
+	addToLevel(root);
+	for (unsigned int i = 1; i < subtree.size(); i++)
+	{
+		SceneNode &node = nodes[subtree[i]];
+		node.depth = nodes[node.parent].depth + 1;
+		addToLevel(subtree[i]);
+	}
+
+	//the subtree's worlds are relative to a new parent, rebuild them next propagate
+	relinked.push_back(root);
+}
+
+bool SceneGraph::attach(EntityStorage &storage, EntityHandle child, EntityHandle parent)
+{
+	if (!storage.isLive(child) || !storage.isLive(parent) || child == parent)
+		return 0;
+	getNode(child.index);
+	getNode(parent.index);
+	for (unsigned int up = parent.index; up != NO_PARENT; up = nodes[up].parent)
+	{
+		if (up == child.index)
+			return 0;
+	}
+	if (nodes[child.index].parent == parent.index)
+		return 1;
+	moveSubtree(child.index, parent.index);
+	return 1;
+}
+
+void SceneGraph::detach(unsigned int entity)
+{
+	if (entity >= nodes.size() || nodes[entity].parent == NO_PARENT)
+		return;
+	moveSubtree(entity, NO_PARENT);
+}
+
+void SceneGraph::removeEntity(unsigned int entity)
+{
+	if (entity >= nodes.size())
+		return;
+	detach(entity);
+	if (nodes[entity].childCount > 0 && levels.size() > 1)
+	{
+		//a root's children are all in level 1
+		std::vector<unsigned int> children;
+		const SceneLevel &level = levels[1];
+		for (unsigned int i = 0; i < level.entities.size(); i++)
+		{
+			if (level.parents[i] == entity)
+				children.push_back(level.entities[i]);
+		}
+		for (unsigned int i = 0; i < children.size(); i++)
+			moveSubtree(children[i], NO_PARENT);
+	}
+}
+
+void SceneGraph::propagate(EntityStorage &storage, ThreadPool *workers)
+{
+	//the storage already rebuilt the moved entities' worlds as if they were roots
+	//attached ones still need their parent's world, and so does everything under them
+	updated.clear();
+	std::vector<unsigned char> levelChanged(levels.size() > 0 ? levels.size() : 1, 0);
+	const std::vector<EntityHandle> &moved = storage.getMoved();
+	for (unsigned int i = 0; i < moved.size(); i++)
+	{
+		unsigned int entity = moved[i].index;
+		if (entity >= nodes.size())
+			continue;
+		changed[entity] = 1;
+		levelChanged[nodes[entity].depth] = 1;
+	}
+	for (unsigned int i = 0; i < relinked.size(); i++)
+	{
+		unsigned int entity = relinked[i];
+		//destroyed since, nothing to rebuild
+		if (!storage.isLive(storage.getHandle(entity)))
+			continue;
+		//detached, its world is just its own transform again
+		if (nodes[entity].depth == 0)
+		{
+			storage.updateWorld(entity);
+			updated.push_back(entity);
+		}
+		changed[entity] = 1;
+		levelChanged[nodes[entity].depth] = 1;
+	}
+
+	//a level is only touched if something in it moved or anything above it changed
+	unsigned int firstLevel = levels.size();
+	for (unsigned int d = 0; d < levels.size() && firstLevel == levels.size(); d++)
+	{
+		if (levelChanged[d])
+			firstLevel = d > 0 ? d : 1;
+	}
+	for (unsigned int d = firstLevel; d < levels.size(); d++)
+	{
+		const SceneLevel &level = levels[d];
+		std::function<void(unsigned int, unsigned int)> job = [this, &storage, &level](unsigned int first, unsigned int count)
+		{
+			for (unsigned int i = first; i < first + count; i++)
+			{
+				unsigned int entity = level.entities[i];
+				unsigned int parent = level.parents[i];
+				if (!changed[parent] && !changed[entity])
+					continue;
+				storage.getWorld(entity) = storage.getWorld(parent) * storage.getTransform(entity).getMatrix();
+				changed[entity] = 1;
+			}
+		};
+		if (workers != NULL)
+			workers->parallelFor(level.entities.size(), PROPAGATE_GRAIN, job);
+		else
+			job(0, level.entities.size());
+	}
+
+	//clear only what could have been set, noting which attached entities were rebuilt
+	for (unsigned int d = firstLevel; d < levels.size(); d++)
+	{
+		const SceneLevel &level = levels[d];
+		for (unsigned int i = 0; i < level.entities.size(); i++)
+		{
+			unsigned int entity = level.entities[i];
+			if (changed[entity])
+				updated.push_back(entity);
+			changed[entity] = 0;
+		}
+	}
+	for (unsigned int i = 0; i < moved.size(); i++)
+	{
+		if (moved[i].index < changed.size())
+			changed[moved[i].index] = 0;
+	}
+	for (unsigned int i = 0; i < relinked.size(); i++)
+		changed[relinked[i]] = 0;
+	relinked.clear();
+}
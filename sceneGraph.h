@@ -0,0 +1,68 @@
+#ifndef Z_SCENEGRAPH
+#define Z_SCENEGRAPH
+
+#include <vector>
+
+#include "entityStorage.h"
+#include "threadPool.h"
+
+//Parent/child links between entities, an attached entity's transform is relative to its parent
+//and its world matrix follows the parent's
+//attached entities are kept in one list per depth, so a level only reads worlds the level above already finished
+//and every level can be updated in parallel
+//only the world matrices are kept here, the entity manager moves attached bodies to match
+class SceneGraph
+{
+	//Where an entity sits in the hierarchy, by entity slot
+	struct SceneNode
+	{
+		unsigned int parent; //parent slot, NO_PARENT for roots
+		unsigned int depth; //0 for roots, which aren't in any level
+		unsigned int levelIndex; //position in its level
+		unsigned int childCount;
+	};
+	//Every attached entity at one depth, parents are all one level up
+	struct SceneLevel
+	{
+		std::vector<unsigned int> entities; //slots
+		std::vector<unsigned int> parents; //parent slot per entity, so propagating never touches the nodes
+	};
+
+	std::vector<SceneNode> nodes; //by entity slot, only as far as the largest slot ever linked
+	std::vector<SceneLevel> levels; //by depth, levels[0] stays empty
+	std::vector<unsigned char> changed; //by entity slot, did its world change in this propagate
+	std::vector<unsigned int> relinked; //slots given a new parent since the last propagate
+	std::vector<unsigned int> updated; //slots whose world the last propagate rebuilt
+
+	SceneNode& getNode(unsigned int entity);
+	void addToLevel(unsigned int entity);
+	void removeFromLevel(unsigned int entity);
+	void moveSubtree(unsigned int root, unsigned int parent);
+public:
+	static const unsigned int NO_PARENT = 0xFFFFFFFF;
+	//entities per job when propagating a level
+	static const unsigned int PROPAGATE_GRAIN = 256;
+
+	//make child follow parent, child's subtree comes with it
+	//returns false if either isn't alive or parent is in child's subtree
+	bool attach(EntityStorage &storage, EntityHandle child, EntityHandle parent);
+	//make an entity a root again, its children stay attached to it
+	void detach(unsigned int entity);
+	//forget a destroyed entity, its children become roots
+	void removeEntity(unsigned int entity);
+	//get an entity's parent slot, NO_PARENT if it's a root
+	unsigned int getParent(unsigned int entity) const
+	{ return entity < nodes.size() ? nodes[entity].parent : NO_PARENT; }
+	//deepest level in use plus one
+	unsigned int getLevelCount() const
+	{ return levels.size(); }
+
+	//rebuild the world matrices of attached entities that moved or whose parent's world changed
+	//call after the storage rebuilt the moved entities' own matrices, levels nothing above changed in are skipped
+	void propagate(EntityStorage &storage, ThreadPool *workers);
+	//entities whose world matrix the last propagate rebuilt, moved ones can be in it too
+	const std::vector<unsigned int>& getUpdated() const
+	{ return updated; }
+};
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef Z_SIMD
+#define Z_SIMD
+
+//Use SSE2 for the texture filters, block encoders and culling where the compiler targets it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define Z_SSE2
+#endif
+
+#endif
@@ -0,0 +1,168 @@
+#include <fstream>
+#include <string.h>
+#include <algorithm>
+
+#include "textureCache.h"
+
+const char TEXTURE_CACHE_MAGIC[4] = { 'Z', 'T', 'E', 'X' };
+const unsigned int TEXTURE_CACHE_VERSION = 1;
+
+//File layout: header, the level table, then every level's pixels 16 byte aligned
+struct TextureCacheHeader
+{
+	char magic[4];
+	unsigned int version;
+	unsigned long long sourceHash;
+	unsigned int cookFlags;
+	unsigned int format; //TextureFormat
+	unsigned int comp; //channels in the source image
+	unsigned int levelCount;
+	unsigned int levelsOffset;
+	unsigned int fileSize;
+};
+
+//One entry of the level table
+struct TextureCacheLevel
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned int offset; //from the start of the file
+	unsigned int size;
+};
+
+//round up to the section alignment
+static unsigned int alignSection(unsigned int offset)
+{
+	return (offset + 15) & ~15u;
+}
+
+//does count elements of size bytes starting at offset fit in the file, done in 64 bit so it can't wrap
+static bool inFile(unsigned int offset, unsigned long long count, unsigned long long size, unsigned int fileSize)
+{
+	return offset <= fileSize && count * size <= (unsigned long long)(fileSize - offset);
+}
+
+TextureView getTextureView(const MipChain &mips, int comp)
+{
+	TextureView view = TextureView();
+	view.format = mips.format;
+	view.comp = comp;
+	view.levelCount = std::min(mips.getLevelCount(), MAX_TEXTURE_LEVELS);
+	for (unsigned int i = 0; i < view.levelCount; i++)
+	{
+		view.levels[i].width = mips.levels[i].width;
+		view.levels[i].height = mips.levels[i].height;
+		view.levels[i].pixels = mips.getLevel(i);
+		view.levels[i].size = mips.levels[i].size;
+	}
+	return view;
+}
+
+TextureCache::TextureCache()
+{
+	view = TextureView();
+}
+
+unsigned long long TextureCache::hashSource(std::string filepath)
+{
+	MappedFile source;
+	if (!source.open(filepath))
+		return 0;
+	return hashBytes(source.getData(), source.getSize());
+}
+
+bool TextureCache::write(std::string cachePath, const MipChain &mips, int comp, unsigned long long sourceHash, unsigned int cookFlags)
+{
+	TextureCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TEXTURE_CACHE_MAGIC, 4);
+	header.version = TEXTURE_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.cookFlags = cookFlags;
+	header.format = mips.format;
+	header.comp = comp;
+	header.levelCount = mips.getLevelCount();
+	header.levelsOffset = alignSection(sizeof(TextureCacheHeader));
+
+	std::vector<TextureCacheLevel> levels(header.levelCount);
+	unsigned int offset = alignSection(header.levelsOffset + header.levelCount * sizeof(TextureCacheLevel));
+	for (unsigned int i = 0; i < header.levelCount; i++)
+	{
+		levels[i].width = mips.levels[i].width;
+		levels[i].height = mips.levels[i].height;
+		levels[i].offset = offset;
+		levels[i].size = mips.levels[i].size;
+		offset = alignSection(offset + levels[i].size);
+	}
+	header.fileSize = offset;
+
+	std::vector<char> buffer(header.fileSize, 0);
+	memcpy(&buffer[0], &header, sizeof(header));
+	if (header.levelCount > 0)
+		memcpy(&buffer[header.levelsOffset], &levels[0], header.levelCount * sizeof(TextureCacheLevel));
+	for (unsigned int i = 0; i < header.levelCount; i++)
+		memcpy(&buffer[levels[i].offset], mips.getLevel(i), levels[i].size);
+
+	std::ofstream out(cachePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return 0;
+	out.write(&buffer[0], buffer.size());
+	return out.good();
+}
+
+bool TextureCache::open(std::string cachePath, unsigned long long sourceHash, unsigned int cookFlags)
+{
+	close();
+	if (!file.open(cachePath))
+		return 0;
+
+	//check the cache is complete and was cooked from this exact source
+	const TextureCacheHeader *header = (const TextureCacheHeader*)file.getData();
+	if (file.getSize() < sizeof(TextureCacheHeader) ||
+		memcmp(header->magic, TEXTURE_CACHE_MAGIC, 4) != 0 ||
+		header->version != TEXTURE_CACHE_VERSION ||
+		header->sourceHash != sourceHash ||
+		header->cookFlags != cookFlags ||
+		header->fileSize != file.getSize() ||
+		header->levelCount == 0 || header->levelCount > MAX_TEXTURE_LEVELS)
+	{
+		close();
+		return 0;
+	}
+
+	//a truncated or corrupt table mustn't point outside the mapping, re-cook instead
+	const unsigned char *base = file.getData();
+	if (!inFile(header->levelsOffset, header->levelCount, sizeof(TextureCacheLevel), header->fileSize))
+	{
+		close();
+		return 0;
+	}
+	const TextureCacheLevel *levels = (const TextureCacheLevel*)(base + header->levelsOffset);
+	for (unsigned int i = 0; i < header->levelCount; i++)
+	{
+		if (!inFile(levels[i].offset, levels[i].size, 1, header->fileSize))
+		{
+			close();
+			return 0;
+		}
+	}
+
+	//the levels are uploaded straight from the mapping, nothing is copied
+	view.format = (TextureFormat)header->format;
+	view.comp = header->comp;
+	view.levelCount = header->levelCount;
+	for (unsigned int i = 0; i < header->levelCount; i++)
+	{
+		view.levels[i].width = levels[i].width;
+		view.levels[i].height = levels[i].height;
+		view.levels[i].pixels = base + levels[i].offset;
+		view.levels[i].size = levels[i].size;
+	}
+	return 1;
+}
+
+void TextureCache::close()
+{
+	file.close();
+	view = TextureView();
+}
@@ -0,0 +1,66 @@
+#ifndef Z_TEXCACHE
+#define Z_TEXCACHE
+
+#include <string>
+
+#include "mappedFile.h"
+#include "mipChain.h"
+
+//Most mip levels a texture can have, enough for 32768x32768
+const unsigned int MAX_TEXTURE_LEVELS = 16;
+
+//Pointers to one mip level's pixels
+struct TextureLevelView
+{
+	int width;
+	int height;
+	const unsigned char *pixels;
+	size_t size; //bytes in the level
+};
+
+//Pointers to a texture's levels, either into a MipChain or straight into a mapped cache file
+struct TextureView
+{
+	TextureFormat format;
+	int comp; //channels in the source image
+	unsigned int levelCount;
+	TextureLevelView levels[MAX_TEXTURE_LEVELS]; //full size first
+};
+
+//Get a view over a chain that lives in memory
+TextureView getTextureView(const MipChain &mips, int comp);
+
+//Cooked binary copy of a texture that is memory mapped instead of decoded
+//every mip level is stored in its upload format, raw RGBA8 or block compressed
+class TextureCache
+{
+	MappedFile file; //the mapped cache file
+	TextureView view; //pointers into the mapping
+public:
+	TextureCache();
+
+	//where the cooked copy of a texture file lives
+	static std::string getCachePath(std::string filepath)
+	{ return filepath + ".ztex"; }
+	//hash the source file, the cache is only valid for the same hash
+	static unsigned long long hashSource(std::string filepath);
+	//write a cooked texture to disk, comp is the channel count of the source image
+	static bool write(std::string cachePath, const MipChain &mips, int comp, unsigned long long sourceHash, unsigned int cookFlags);
+
+	//map a cooked texture, fails if missing or built from another source or with other cook flags
+	bool open(std::string cachePath, unsigned long long sourceHash, unsigned int cookFlags);
+	//unmap the cooked texture, invalidates the view
+	void close();
+	//is a cooked texture mapped
+	bool isOpen() const
+	{ return file.isOpen(); }
+
+	//size of the mapped file
+	size_t getFileSize() const
+	{ return file.getSize(); }
+	//get the mapped levels, only valid while open
+	const TextureView& getView() const
+	{ return view; }
+};
+
+#endif
@@ -1,51 +1,742 @@
+#include <algorithm>
+
 #include "textureManager.h"
 
-GLuint TextureManager::checkIfTextureExists(std::string filepath)
+//Rows of 4x4 blocks each compression job encodes
+const unsigned int COMPRESS_JOB_ROWS = 16;
+//Streamed textures start at the first level this size or smaller
+const int STREAM_BASE_SIZE = 64;
+//Most streamed textures that get a finer level each frame
+const unsigned int STREAM_UPLOADS_PER_FRAME = 4;
+//Names the texture arrays' unused layers and the placeholder are counted under in the resource tracker
+const char *TEXTURE_SLACK_NAME = "texture arrays";
+const char *PLACEHOLDER_NAME = "texture placeholder";
+
+//decode an image file and build its mips, safe to run on a worker thread
+static bool decodeTexture(std::string filepath, MipChain &mips, int &comp)
 {
-	if (fileNames.size() < 1)
-		return -1;
+	//always expand to RGBA, the mip filter and the GL formats only deal with that
+	int width, height;
+	unsigned char *image = stbi_load(filepath.c_str(), &width, &height, &comp, 4);
+	if (image == NULL)
+		return 0;
+	buildMipChain(image, width, height, mips);
+	stbi_image_free(image);
+	return 1;
+}
 
-	for (GLuint i = 0; i < fileNames.size(); i++)
+//what the cooked copy was built with, a cache made with other settings is rebuilt
+static unsigned int getCookFlags(TextureCompression mode, EncodeQuality quality)
+{
+	return mode | quality << 4;
+}
+
+//pick the block format for a decoded RGBA8 chain
+static TextureFormat chooseFormat(TextureCompression mode, const MipChain &mips, int comp)
+{
+	if (mode == COMPRESS_BC7)
+		return TEXTURE_BC7;
+
+	//stbi always fills alpha in, only images that had an alpha channel can need BC3
+	if (comp == 2 || comp == 4)
 	{
-		if (!filepath.compare(fileNames.at(i)))
-			return textures.at(i);
+		const unsigned char *pixels = mips.getLevel(0);
+		size_t count = mips.levels[0].size / 4;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (pixels[i * 4 + 3] != 255)
+				return TEXTURE_BC3;
+		}
 	}
-	return -1;
+	return TEXTURE_BC1;
 }
 
-GLuint TextureManager::importTexture(std::string filepath)
+//Block rows of one level a compression job encodes
+struct RowRange
 {
-	GLuint preCheck = checkIfTextureExists(filepath);
-	if (preCheck != -1)
-		return preCheck;
+	unsigned int level;
+	unsigned int firstRow;
+	unsigned int rowCount;
+};
 
-	int width, height, comp;
-	unsigned char *image = stbi_load(filepath.c_str(), &width, &height, &comp, NULL);
-	if (image == NULL)
+//split every level of a chain into jobs of COMPRESS_JOB_ROWS block rows
+static void getRowRanges(const MipChain &source, std::vector<RowRange> &ranges)
+{
+	for (unsigned int i = 0; i < source.getLevelCount(); i++)
+	{
+		unsigned int rows = getBlockRows(source.levels[i]);
+		for (unsigned int row = 0; row < rows; row += COMPRESS_JOB_ROWS)
+		{
+			RowRange range = { i, row, std::min(COMPRESS_JOB_ROWS, rows - row) };
+			ranges.push_back(range);
+		}
+	}
+}
+
+//turn a decoded RGBA8 chain into the import mode's format, the block rows are shared with workers if there are any
+//the calling thread helps and returns once every row is done
+static void encodeTexture(MipChain &source, TextureCompression mode, EncodeQuality quality, int comp, MipChain &mips, ThreadPool *workers)
+{
+	if (mode == COMPRESS_NONE)
+	{
+		mips.format = source.format;
+		mips.levels.swap(source.levels);
+		mips.pixels.swap(source.pixels);
+		return;
+	}
+	prepareCompressedChain(source, chooseFormat(mode, source, comp), mips);
+	std::vector<RowRange> ranges;
+	getRowRanges(source, ranges);
+	std::function<void(unsigned int, unsigned int)> job = [&source, &ranges, quality, &mips](unsigned int first, unsigned int count)
+	{
+		for (unsigned int i = first; i < first + count; i++)
+			compressBlockRows(source, ranges[i].level, ranges[i].firstRow, ranges[i].rowCount, quality, mips);
+	};
+	if (workers != NULL)
+		workers->parallelFor(ranges.size(), 1, job);
+	else
+		job(0, ranges.size());
+}
+
+//write the cooked copy of a texture, a failure only costs the next run a decode
+static void writeCooked(std::string filepath, const MipChain &mips, int comp, unsigned long long sourceHash, unsigned int cookFlags)
+{
+	std::string cachePath = TextureCache::getCachePath(filepath);
+	if (!TextureCache::write(cachePath, mips, comp, sourceHash, cookFlags))
+		reportError("Failed to write texture cache!(" + cachePath + ")", 0);
+}
+
+//load a texture with the given import mode, maps its cooked copy if it has an up to date one
+//otherwise decodes and encodes into mips and cooks it
+static bool cookTexture(std::string filepath, TextureCompression mode, EncodeQuality quality, TextureCache &cache, MipChain &mips, int &comp, unsigned long long &sourceHash, ThreadPool *workers)
+{
+	sourceHash = TextureCache::hashSource(filepath);
+	unsigned int cookFlags = getCookFlags(mode, quality);
+	if (cache.open(TextureCache::getCachePath(filepath), sourceHash, cookFlags))
+	{
+		comp = cache.getView().comp;
+		return 1;
+	}
+
+	MipChain source;
+	if (!decodeTexture(filepath, source, comp))
+		return 0;
+	encodeTexture(source, mode, quality, comp, mips, workers);
+	writeCooked(filepath, mips, comp, sourceHash, cookFlags);
+	return 1;
+}
+
+//GL internal format of a block compressed texture
+static GLenum getCompressedFormat(TextureFormat format)
+{
+	switch (format)
+	{
+	case TEXTURE_BC1:
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TEXTURE_BC3:
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TEXTURE_BC7:
+		return GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+	default:
+		return 0;
+	}
+}
+
+//bytes in one layer of a level
+static size_t getLayerSize(TextureFormat format, int width, int height)
+{
+	if (format == TEXTURE_RGBA8)
+		return (size_t)width * height * 4;
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+}
+
+//bytes of every level in a view
+static size_t getViewBytes(const TextureView &view)
+{
+	size_t bytes = 0;
+	for (unsigned int i = 0; i < view.levelCount; i++)
+		bytes += view.levels[i].size;
+	return bytes;
+}
+
+//bytes a pool has allocated for layers nothing uses
+static size_t getPoolSlack(const TexturePool &pool)
+{
+	size_t layerBytes = 0;
+	int w = pool.width;
+	int h = pool.height;
+	for (unsigned int i = 0; i < pool.levelCount; i++)
+	{
+		layerBytes += getLayerSize(pool.format, w, h);
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+	return layerBytes * (pool.capacity - pool.liveCount);
+}
+
+//allocate every level of an array texture with undefined layers, leaves it bound
+static GLuint allocateArray(TextureFormat format, int width, int height, unsigned int levelCount, unsigned int layers)
+{
+	GLuint arrayID;
+	glGenTextures(1, &arrayID);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrayID);
+
+	int w = width;
+	int h = height;
+	for (unsigned int i = 0; i < levelCount; i++)
+	{
+		if (format == TEXTURE_RGBA8)
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA8, w, h, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		else
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, getCompressedFormat(format), w, h, layers, 0, getLayerSize(format, w, h) * layers, NULL);
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return arrayID;
+}
+
+//copy a texture's levels into one layer of the bound array, the pixels may point straight into a mapped cache
+static void uploadLayer(GLuint layer, const TextureView &view)
+{
+	for (unsigned int i = 0; i < view.levelCount; i++)
+	{
+		const TextureLevelView &level = view.levels[i];
+		if (view.format == TEXTURE_RGBA8)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.width, level.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, level.pixels);
+		else
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.width, level.height, 1, getCompressedFormat(view.format), level.size, level.pixels);
+	}
+}
+
+//give a texture a slot, new slots start out not resident
+AssetHandle TextureManager::reserveTexture(std::string filepath)
+{
+	AssetHandle texture = registry.add(filepath);
+	if (texture.index >= slices.size())
+	{
+		TextureSlice none = { 0, 0 };
+		slices.resize(texture.index + 1, none);
+		slotPools.resize(texture.index + 1, 0);
+		slotBytes.resize(texture.index + 1, 0);
+		streams.resize(texture.index + 1, TextureStream());
+		resident.resize(texture.index + 1, 0);
+	}
+	return texture;
+}
+
+//2x2 magenta and black checker, made on first use since it needs the GL context
+//it has its own array so it can be sampled nearest
+TextureSlice TextureManager::getPlaceholder()
+{
+	if (placeholder.array == 0)
+	{
+		const unsigned char checker[] = {
+			255, 0, 255, 255, 0, 0, 0, 255,
+			0, 0, 0, 255, 255, 0, 255, 255
+		};
+		MipChain mips;
+		buildMipChain(checker, 2, 2, mips);
+		placeholder.array = allocateArray(mips.format, 2, 2, mips.getLevelCount(), 1);
+		uploadLayer(0, getTextureView(mips, 4));
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		ResourceTracker::get().add(RESOURCE_TEXTURES, PLACEHOLDER_NAME, mips.pixels.size());
+	}
+	return placeholder;
+}
+
+//put a texture in a free layer of a pool with the same format and size, making the pool if there isn't one
+//exclusive textures get a pool of their own, reusing an empty one if there is one
+TextureSlice TextureManager::addToPool(const TextureView &view, unsigned int &poolIndex, bool exclusive)
+{
+	if (maxLayers == 0)
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+	poolIndex = pools.size();
+	for (unsigned int i = 0; i < pools.size(); i++)
+	{
+		const TexturePool &pool = pools.at(i);
+		if (exclusive ? pool.exclusive && pool.array == 0 :
+			!pool.exclusive && pool.format == view.format && pool.width == view.levels[0].width && pool.height == view.levels[0].height &&
+			pool.levelCount == view.levelCount && (!pool.freeLayers.empty() || pool.layerCount < (unsigned int)maxLayers))
+		{
+			poolIndex = i;
+			break;
+		}
+	}
+	if (poolIndex == pools.size())
+		pools.push_back(TexturePool());
+
+	TexturePool &pool = pools.at(poolIndex);
+	size_t slack = pool.array == 0 ? 0 : getPoolSlack(pool);
+	if (pool.array == 0)
+	{
+		pool.format = view.format;
+		pool.width = view.levels[0].width;
+		pool.height = view.levels[0].height;
+		pool.levelCount = view.levelCount;
+		pool.capacity = 0;
+		pool.layerCount = 0;
+		pool.liveCount = 0;
+		pool.exclusive = exclusive;
+	}
+	GLuint layer;
+	if (!pool.freeLayers.empty())
+	{
+		layer = pool.freeLayers.back();
+		pool.freeLayers.pop_back();
+		glBindTexture(GL_TEXTURE_2D_ARRAY, pool.array);
+	}
+	else
+	{
+		if (pool.layerCount < pool.capacity)
+			glBindTexture(GL_TEXTURE_2D_ARRAY, pool.array);
+		else
+		{
+			growPool(pool);
+			//the pool moved to a new array, point its textures at it
+			for (unsigned int i = 0; i < slices.size(); i++)
+			{
+				if (resident[i] && slotPools[i] == poolIndex)
+					slices[i].array = pool.array;
+			}
+		}
+		layer = pool.layerCount++;
+	}
+
+	uploadLayer(layer, view);
+	pool.liveCount++;
+
+	//growing may have allocated more layers than the one just used
+	ResourceTracker &tracker = ResourceTracker::get();
+	tracker.add(RESOURCE_TEXTURE_SLACK, TEXTURE_SLACK_NAME, getPoolSlack(pool));
+	tracker.remove(RESOURCE_TEXTURE_SLACK, TEXTURE_SLACK_NAME, slack);
+
+	TextureSlice slice = { pool.array, layer };
+	return slice;
+}
+
+//double a pool's layers, the old layers are copied over through a pixel buffer so they never leave the GPU
+//leaves the new array bound
+void TextureManager::growPool(TexturePool &pool)
+{
+	//new pools hold one layer, most textures are one-offs and every spare layer costs a whole mip chain
+	unsigned int capacity = pool.exclusive || pool.capacity == 0 ? 1 : std::min(pool.capacity * 2, (unsigned int)maxLayers);
+	GLuint grown = allocateArray(pool.format, pool.width, pool.height, pool.levelCount, capacity);
+
+	if (pool.array != 0)
+	{
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		int w = pool.width;
+		int h = pool.height;
+		for (unsigned int i = 0; i < pool.levelCount; i++)
+		{
+			size_t bytes = getLayerSize(pool.format, w, h) * pool.capacity;
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+			glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_COPY);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, pool.array);
+			if (pool.format == TEXTURE_RGBA8)
+				glGetTexImage(GL_TEXTURE_2D_ARRAY, i, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+			else
+				glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, i, (void*)0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, grown);
+			if (pool.format == TEXTURE_RGBA8)
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, 0, w, h, pool.capacity, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+			else
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, 0, w, h, pool.capacity, getCompressedFormat(pool.format), bytes, (void*)0);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			w = std::max(1, w / 2);
+			h = std::max(1, h / 2);
+		}
+		glDeleteBuffers(1, &buffer);
+		glDeleteTextures(1, &pool.array);
+	}
+
+	pool.array = grown;
+	pool.capacity = capacity;
+}
+
+//give a layer back to its pool, the array is deleted once the pool is empty
+void TextureManager::removeFromPool(unsigned int poolIndex, GLuint layer)
+{
+	TexturePool &pool = pools.at(poolIndex);
+	ResourceTracker &tracker = ResourceTracker::get();
+	size_t slack = getPoolSlack(pool);
+	pool.liveCount--;
+	if (pool.liveCount > 0)
+	{
+		pool.freeLayers.push_back(layer);
+		tracker.add(RESOURCE_TEXTURE_SLACK, TEXTURE_SLACK_NAME, getPoolSlack(pool) - slack);
+		return;
+	}
+	tracker.remove(RESOURCE_TEXTURE_SLACK, TEXTURE_SLACK_NAME, slack);
+	glDeleteTextures(1, &pool.array);
+	pool.array = 0;
+	pool.capacity = 0;
+	pool.layerCount = 0;
+	pool.freeLayers.clear();
+}
+
+//upload a loaded texture into its slot, streamed textures only get their small mips
+void TextureManager::uploadTexture(GLuint index, const TextureView &view, std::string filepath, unsigned long long sourceHash, unsigned int cookFlags)
+{
+	//streaming needs the cooked copy to page from, without one the whole texture is uploaded
+	if (streaming && startStream(index, TextureCache::getCachePath(filepath), sourceHash, cookFlags))
+		return;
+
+	unsigned int poolIndex;
+	slices[index] = addToPool(view, poolIndex);
+	slotPools[index] = poolIndex;
+	resident[index] = 1;
+	slotBytes[index] = getViewBytes(view);
+	ResourceTracker::get().add(RESOURCE_TEXTURES, filepath, slotBytes[index]);
+}
+
+//map a texture's cooked copy and upload its levels from the base level down
+bool TextureManager::startStream(GLuint index, std::string cachePath, unsigned long long sourceHash, unsigned int cookFlags)
+{
+	TextureCache *source = new TextureCache;
+	if (!source->open(cachePath, sourceHash, cookFlags))
+	{
+		delete source;
+		return 0;
+	}
+
+	ResourceTracker::get().add(RESOURCE_MAPPED_FILES, registry.getSlotPath(index), source->getFileSize());
+	const TextureView &view = source->getView();
+	GLuint base = 0;
+	while (base + 1 < view.levelCount && std::max(view.levels[base].width, view.levels[base].height) > STREAM_BASE_SIZE)
+		base++;
+
+	TextureStream &stream = streams[index];
+	stream.source = source;
+	stream.baseLevel = base;
+	stream.wantedLevel = base;
+	stream.lastUsed = frame;
+	stream.bytes = 0;
+	setStreamLevel(index, base);
+	return 1;
+}
+
+//swap a streamed texture's layer for one with level as its finest mip
+//it gets its own array, so the memory of dropped mips is really freed
+void TextureManager::setStreamLevel(GLuint index, GLuint level)
+{
+	TextureStream &stream = streams[index];
+	const TextureView &full = stream.source->getView();
+	TextureView view = full;
+	view.levelCount = full.levelCount - level;
+	for (unsigned int i = 0; i < view.levelCount; i++)
+		view.levels[i] = full.levels[i + level];
+	size_t bytes = getViewBytes(view);
+
+	ResourceTracker &tracker = ResourceTracker::get();
+	const std::string &name = registry.getSlotPath(index);
+	if (resident[index])
+	{
+		removeFromPool(slotPools[index], slices[index].layer);
+		tracker.remove(RESOURCE_TEXTURES, name, slotBytes[index]);
+	}
+	unsigned int poolIndex;
+	slices[index] = addToPool(view, poolIndex, 1);
+	slotPools[index] = poolIndex;
+	resident[index] = 1;
+	slotBytes[index] = bytes;
+	tracker.add(RESOURCE_TEXTURES, name, bytes);
+
+	streamBytes = streamBytes - stream.bytes + bytes;
+	stream.bytes = bytes;
+	stream.topLevel = level;
+}
+
+//evict mips, least recently used first, until bytes more fit in the budget
+//never evicts keep or mips a texture drawn last frame still needs, fails if that isn't enough
+bool TextureManager::makeRoom(size_t bytes, GLuint keep)
+{
+	while (streamBytes + bytes > streamBudget)
+	{
+		GLuint victim = streams.size();
+		for (GLuint i = 0; i < streams.size(); i++)
+		{
+			const TextureStream &stream = streams[i];
+			if (stream.source == NULL || i == keep || stream.topLevel >= stream.baseLevel)
+				continue;
+			if (stream.lastUsed == frame && stream.topLevel >= stream.wantedLevel)
+				continue;
+			if (victim == streams.size() || stream.lastUsed < streams[victim].lastUsed ||
+				(stream.lastUsed == streams[victim].lastUsed && stream.bytes > streams[victim].bytes))
+				victim = i;
+		}
+		if (victim == streams.size())
+			return 0;
+		setStreamLevel(victim, streams[victim].topLevel + 1);
+	}
+	return 1;
+}
+
+void TextureManager::markUsed(AssetHandle texture, float screenPixels)
+{
+	if (!registry.isLive(texture))
+		return;
+	TextureStream &stream = streams[texture.index];
+	if (stream.source == NULL)
+		return;
+
+	//finest level still no bigger than it's drawn, assuming the UVs cover the texture about once
+	const TextureView &view = stream.source->getView();
+	int size = std::max(view.levels[0].width, view.levels[0].height);
+	GLuint level = 0;
+	while (level < stream.baseLevel && (size >> (level + 1)) >= screenPixels)
+		level++;
+	stream.wantedLevel = std::min(stream.wantedLevel, level);
+	stream.lastUsed = frame;
+}
+
+void TextureManager::updateStreaming()
+{
+	//textures drawn last frame that want finer mips, the furthest from what they want first
+	std::vector<GLuint> wanting;
+	for (GLuint i = 0; i < streams.size(); i++)
+	{
+		const TextureStream &stream = streams[i];
+		if (stream.source != NULL && stream.lastUsed == frame && stream.wantedLevel < stream.topLevel)
+			wanting.push_back(i);
+	}
+	std::sort(wanting.begin(), wanting.end(), [this](GLuint a, GLuint b)
+	{
+		return streams[a].topLevel - streams[a].wantedLevel > streams[b].topLevel - streams[b].wantedLevel;
+	});
+
+	//one level at a time, so a frame never stalls on a lot of uploads
+	for (unsigned int i = 0; i < wanting.size() && i < STREAM_UPLOADS_PER_FRAME; i++)
+	{
+		TextureStream &stream = streams[wanting[i]];
+		if (!makeRoom(stream.source->getView().levels[stream.topLevel - 1].size, wanting[i]))
+			break;
+		setStreamLevel(wanting[i], stream.topLevel - 1);
+	}
+	//the budget may have been lowered
+	makeRoom(0, streams.size());
+
+	//next frame's draws ask again from scratch
+	frame++;
+	for (GLuint i = 0; i < streams.size(); i++)
+		streams[i].wantedLevel = streams[i].baseLevel;
+}
+
+void TextureManager::setCompression(TextureCompression mode, EncodeQuality quality)
+{
+	if (mode == COMPRESS_BC7 && !GLEW_ARB_texture_compression_bptc)
+	{
+		reportError("BC7 textures aren't supported, using BC1/BC3", 0);
+		mode = COMPRESS_BC1_BC3;
+	}
+	if (mode == COMPRESS_BC1_BC3 && !GLEW_EXT_texture_compression_s3tc)
+	{
+		reportError("BC1/BC3 textures aren't supported, textures won't be compressed", 0);
+		mode = COMPRESS_NONE;
+	}
+	compression = mode;
+	encodeQuality = quality;
+}
+
+AssetHandle TextureManager::importTexture(std::string filepath)
+{
+	AssetHandle loaded = registry.acquire(filepath);
+	if (loaded.isValid())
+		return loaded;
+
+	TextureCache cache;
+	MipChain mips;
+	int comp;
+	unsigned long long sourceHash;
+	if (!cookTexture(filepath, compression, encodeQuality, cache, mips, comp, sourceHash, workers))
 	{
 		std::string err = "Image failed to load!(" + filepath + ")";
 		reportError(err, 0);
-		return -1;
+		return AssetHandle();
 	}
 
-	fileNames.push_back(filepath);
+	AssetHandle texture = reserveTexture(filepath);
+	uploadTexture(texture.index, cache.isOpen() ? cache.getView() : getTextureView(mips, comp), filepath, sourceHash, getCookFlags(compression, encodeQuality));
 
-	GLuint textureID;
-	glGenTextures(1, &textureID);
+	return texture;
+}
 
-	glBindTexture(GL_TEXTURE_2D, textureID);
+AssetHandle TextureManager::loadTextureAsync(std::string filepath)
+{
+	AssetHandle loaded = registry.acquire(filepath);
+	if (loaded.isValid())
+		return loaded;
 
-	if (comp == 3)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	else if (comp == 4)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+	if (workers == NULL)
+		return importTexture(filepath);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	AssetHandle texture = reserveTexture(filepath);
+	slices[texture.index] = getPlaceholder();
+	pendingCount++;
 
-	stbi_image_free(image);
+	DecodedTexture *decoded = new DecodedTexture(texture, filepath, compression, encodeQuality);
+	workers->addJob([this, decoded]()
+	{
+		//cooked copy is up to date, the GL thread uploads straight from its mapping
+		decoded->sourceHash = TextureCache::hashSource(decoded->filepath);
+		unsigned int cookFlags = getCookFlags(decoded->compression, decoded->quality);
+		if (decoded->cache.open(TextureCache::getCachePath(decoded->filepath), decoded->sourceHash, cookFlags))
+		{
+			decoded->comp = decoded->cache.getView().comp;
+			decoded->ok = 1;
+			finishDecode(decoded);
+		}
+		else if (!decodeTexture(decoded->filepath, decoded->source, decoded->comp))
+			finishDecode(decoded);
+		else if (decoded->compression == COMPRESS_NONE)
+		{
+			encodeTexture(decoded->source, COMPRESS_NONE, decoded->quality, decoded->comp, decoded->mips, NULL);
+			writeCooked(decoded->filepath, decoded->mips, decoded->comp, decoded->sourceHash, cookFlags);
+			decoded->ok = 1;
+			finishDecode(decoded);
+		}
+		else
+			compressAsync(decoded);
+	});
+	return texture;
+}
+
+//split a decoded texture's compression into jobs of block rows, run from a worker
+void TextureManager::compressAsync(DecodedTexture *decoded)
+{
+	std::vector<RowRange> ranges;
+	getRowRanges(decoded->source, ranges);
+
+	prepareCompressedChain(decoded->source, chooseFormat(decoded->compression, decoded->source, decoded->comp), decoded->mips);
+	//count every job before any is queued, so none can finish the texture early
+	decoded->jobsLeft = ranges.size();
+	for (unsigned int i = 0; i < ranges.size(); i++)
+	{
+		RowRange range = ranges.at(i);
+		workers->addJob([this, decoded, range]()
+		{
+			compressBlockRows(decoded->source, range.level, range.firstRow, range.rowCount, decoded->quality, decoded->mips);
+			if (--decoded->jobsLeft != 0)
+				return;
+
+			//last job, every row is encoded
+			std::vector<unsigned char>().swap(decoded->source.pixels);
+			writeCooked(decoded->filepath, decoded->mips, decoded->comp, decoded->sourceHash, getCookFlags(decoded->compression, decoded->quality));
+			decoded->ok = 1;
+			finishDecode(decoded);
+		});
+	}
+}
+
+//hand a finished texture to the GL thread
+void TextureManager::finishDecode(DecodedTexture *decoded)
+{
+	std::lock_guard<std::mutex> lock(uploadMutex);
+	uploadQueue.push_back(decoded);
+}
+
+void TextureManager::loadTexturesAsync(const std::vector<std::string> &files, std::vector<AssetHandle> &handles)
+{
+	//every decode is queued before any finishes, so they spread over all the workers
+	handles.resize(files.size());
+	for (unsigned int i = 0; i < files.size(); i++)
+		handles[i] = loadTextureAsync(files[i]);
+}
+
+void TextureManager::processUploads()
+{
+	if (pendingCount == 0)
+		return;
+
+	std::vector<DecodedTexture*> ready;
+	{
+		std::lock_guard<std::mutex> lock(uploadMutex);
+		ready.swap(uploadQueue);
+	}
+
+	for (unsigned int i = 0; i < ready.size(); i++)
+	{
+		DecodedTexture *decoded = ready.at(i);
+		pendingCount--;
+		//released while it was decoding, the slot may belong to another texture by now
+		if (registry.isLive(decoded->handle))
+		{
+			//failed textures keep the placeholder
+			if (decoded->ok)
+			{
+				uploadTexture(decoded->handle.index, decoded->getView(), decoded->filepath, decoded->sourceHash, getCookFlags(decoded->compression, decoded->quality));
+			}
+			else
+				reportError("Image failed to load!(" + decoded->filepath + ")", 0);
+		}
+		delete decoded;
+	}
+}
+
+//give back a texture's layer and mapping and clear its slot for reuse
+void TextureManager::freeTexture(GLuint index)
+{
+	ResourceTracker &tracker = ResourceTracker::get();
+	const std::string &name = registry.getSlotPath(index);
+
+	//the placeholder is shared, only uploaded textures have a layer to give back
+	if (resident[index])
+	{
+		removeFromPool(slotPools[index], slices[index].layer);
+		tracker.remove(RESOURCE_TEXTURES, name, slotBytes[index]);
+	}
+	TextureSlice none = { 0, 0 };
+	slices[index] = none;
+	slotBytes[index] = 0;
+	resident[index] = 0;
+
+	TextureStream &stream = streams[index];
+	if (stream.source != NULL)
+	{
+		tracker.remove(RESOURCE_MAPPED_FILES, name, stream.source->getFileSize());
+		streamBytes -= stream.bytes;
+		delete stream.source;
+		stream = TextureStream();
+	}
+}
+
+void TextureManager::releaseTexture(AssetHandle texture)
+{
+	if (registry.release(texture))
+		freeTexture(texture.index);
+}
+
+//delete everything, freeing the last texture in a pool deletes its array
+TextureManager::~TextureManager()
+{
+	//the workers are already stopped, anything they finished is never getting uploaded
+	for (unsigned int i = 0; i < uploadQueue.size(); i++)
+		delete uploadQueue.at(i);
 
-	textures.push_back(textureID);
+	for (unsigned int i = 0; i < resident.size(); i++)
+		freeTexture(i);
 
-	return textureID;
-}
\ No newline at end of file
+	for (unsigned int i = 0; i < pools.size(); i++)
+	{
+		if (pools[i].array != 0)
+			glDeleteTextures(1, &pools[i].array);
+	}
+	if (placeholder.array != 0)
+	{
+		glDeleteTextures(1, &placeholder.array);
+		ResourceTracker::get().remove(RESOURCE_TEXTURES, PLACEHOLDER_NAME, ResourceTracker::get().getAssetBytes(PLACEHOLDER_NAME, RESOURCE_TEXTURES));
+	}
+}
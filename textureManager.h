@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <string>
+#include <mutex>
+#include <atomic>
 
 //Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
 #include <GL/glew.h>
@@ -18,15 +20,193 @@ using namespace glm;
 //Include image loading
 #include "stb_image.h"
 
+#include "assetRegistry.h"
+#include "threadPool.h"
+#include "mipChain.h"
+#include "blockCompress.h"
+#include "textureCache.h"
+#include "resourceTracker.h"
 #include "error.h"
 
+//What textures are block compressed to when they're imported
+enum TextureCompression
+{
+	COMPRESS_NONE, //plain RGBA8
+	COMPRESS_BC1_BC3, //BC1 for opaque textures, BC3 for ones with alpha
+	COMPRESS_BC7 //BC7 for everything
+};
+
+//Pixels a worker decoded, handed to the GL thread for upload
+struct DecodedTexture
+{
+	AssetHandle handle; //texture slot it belongs to
+	std::string filepath;
+	bool ok; //did it decode
+	int comp; //channels in the source image
+	TextureCache cache; //mapped cooked copy, uploaded from directly if it was up to date
+	MipChain mips; //otherwise every level, built on the worker too, compressed if the import mode asks for it
+
+	//block compression, split into jobs over the workers
+	TextureCompression compression; //mode when the load started
+	EncodeQuality quality;
+	unsigned long long sourceHash; //for the cooked copy
+	MipChain source; //RGBA8 chain being compressed into mips
+	std::atomic<unsigned int> jobsLeft; //compression jobs still running, the last one finishes the texture
+
+	DecodedTexture(AssetHandle texture, std::string file, TextureCompression mode, EncodeQuality encodeQuality)
+	{
+		handle = texture;
+		filepath = file;
+		ok = 0;
+		comp = 0;
+		compression = mode;
+		quality = encodeQuality;
+		sourceHash = 0;
+		jobsLeft = 0;
+	}
+
+	//the levels to upload, from the mapping or the chain
+	TextureView getView() const
+	{ return cache.isOpen() ? cache.getView() : getTextureView(mips, comp); }
+};
+
+//Where a texture lives, a layer of a 2D array texture
+struct TextureSlice
+{
+	GLuint array; //GL_TEXTURE_2D_ARRAY
+	GLuint layer;
+};
+
+//One GL_TEXTURE_2D_ARRAY holding every texture of the same format and size
+//textures sharing a pool are drawn without rebinding, only the layer changes
+struct TexturePool
+{
+	TextureFormat format;
+	int width;
+	int height;
+	unsigned int levelCount;
+	GLuint array; //0 while the pool is empty
+	unsigned int capacity; //layers allocated, doubles when it runs out
+	unsigned int layerCount; //layers ever handed out, the rest are untouched
+	unsigned int liveCount; //layers in use
+	std::vector<GLuint> freeLayers; //released layers below layerCount
+	bool exclusive; //holds one streamed texture, so dropping its mips really frees them
+};
+
+//Default VRAM budget of streamed textures
+const size_t DEFAULT_STREAM_BUDGET = 256 * 1024 * 1024;
+
+//Which mips of a streamed texture are on the GPU
+struct TextureStream
+{
+	TextureCache *source; //mapped cooked copy the mips are paged in from, NULL if the texture isn't streamed
+	GLuint topLevel; //finest level uploaded
+	GLuint baseLevel; //level it starts at, never evicted past
+	GLuint wantedLevel; //finest level a draw asked for this frame
+	unsigned int lastUsed; //frame it was last drawn
+	size_t bytes; //GPU bytes of the uploaded levels
+};
+
 class TextureManager
 {
-	std::vector<std::string> fileNames;
-	GLuint checkIfTextureExists(std::string filePath);
-	std::vector<GLuint> textures;
+	AssetRegistry registry; //path lookup and reference counts
+	std::vector<TextureSlice> slices; //layer per registry slot, the placeholder until uploaded
+	std::vector<unsigned int> slotPools; //pool of each uploaded texture
+	std::vector<bool> resident; //has the texture been uploaded
+	std::vector<size_t> slotBytes; //bytes each uploaded texture's layer uses, what it counts in the resource tracker
+	std::vector<TexturePool> pools; //array textures, one or more per format and size
+	GLint maxLayers; //GL_MAX_ARRAY_TEXTURE_LAYERS, 0 until the first upload
+
+	std::vector<TextureStream> streams; //streaming state per registry slot
+	bool streaming; //are textures loaded from now on streamed
+	size_t streamBudget; //bytes the streamed textures may use
+	size_t streamBytes; //bytes the streamed textures use
+	unsigned int frame; //counts updateStreaming calls, for the LRU
+
+	ThreadPool *workers; //decodes async loads
+	std::mutex uploadMutex; //guards uploadQueue
+	std::vector<DecodedTexture*> uploadQueue; //textures the workers finished, waiting for the GL thread
+	unsigned int pendingCount; //async loads not uploaded yet
+	TextureSlice placeholder; //shown while a texture is loading or if it failed, its own array
+
+	TextureCompression compression; //import mode for new textures
+	EncodeQuality encodeQuality; //speed/quality of the block encoders
+
+	AssetHandle reserveTexture(std::string filepath);
+	TextureSlice getPlaceholder();
+	TextureSlice addToPool(const TextureView &view, unsigned int &poolIndex, bool exclusive = false);
+	void growPool(TexturePool &pool);
+	void removeFromPool(unsigned int poolIndex, GLuint layer);
+	void freeTexture(GLuint index);
+	void uploadTexture(GLuint index, const TextureView &view, std::string filepath, unsigned long long sourceHash, unsigned int cookFlags);
+	bool startStream(GLuint index, std::string cachePath, unsigned long long sourceHash, unsigned int cookFlags);
+	void setStreamLevel(GLuint index, GLuint level);
+	bool makeRoom(size_t bytes, GLuint keep);
+	void compressAsync(DecodedTexture *decoded);
+	void finishDecode(DecodedTexture *decoded);
 public:
-	GLuint importTexture(std::string file);
+	TextureManager(ThreadPool *pool = NULL)
+	{
+		workers = pool;
+		pendingCount = 0;
+		maxLayers = 0;
+		placeholder.array = 0;
+		placeholder.layer = 0;
+		streaming = 0;
+		streamBudget = DEFAULT_STREAM_BUDGET;
+		streamBytes = 0;
+		frame = 0;
+		compression = COMPRESS_NONE;
+		encodeQuality = ENCODE_NORMAL;
+	}
+	~TextureManager();
+
+	//block compress textures imported from now on, falls back to what the driver supports
+	//every texture is cooked to a .ztex next to the image, later runs map it instead of decoding
+	void setCompression(TextureCompression mode, EncodeQuality quality = ENCODE_NORMAL);
+	TextureCompression getCompression()
+	{ return compression; }
+	//stream textures loaded from now on, they start at their small mips and the finer ones are paged in
+	//from their .ztex as draws need them, least recently used mips are evicted to stay under the budget
+	void setStreaming(bool enable, size_t budgetBytes = DEFAULT_STREAM_BUDGET)
+	{
+		streaming = enable;
+		streamBudget = budgetBytes;
+	}
+	//GPU bytes the streamed textures use
+	size_t getStreamBytes()
+	{ return streamBytes; }
+	//ask for the mips a draw covering screenPixels needs, call from the draw pass
+	void markUsed(AssetHandle texture, float screenPixels);
+	//page in the mips last frame's draws asked for, evicting to stay under the budget, call once a frame
+	void updateStreaming();
+
+	//load a texture or add a reference to the already loaded one, invalid handle if it fails
+	//blocks until it is loaded, compression is still split over the workers
+	AssetHandle importTexture(std::string file);
+	//start decoding a texture on a worker thread, it shows the placeholder until processUploads uploads it
+	AssetHandle loadTextureAsync(std::string file);
+	//start decoding a batch of textures at once, the handles line up with the files
+	void loadTexturesAsync(const std::vector<std::string> &files, std::vector<AssetHandle> &handles);
+	//upload every texture the workers have decoded, call once a frame on the GL thread
+	void processUploads();
+	//are any async loads still waiting to be uploaded
+	bool isLoading()
+	{ return pendingCount > 0; }
+	//is the texture uploaded, not showing the placeholder
+	bool isResident(AssetHandle texture)
+	{ return registry.isLive(texture) && resident[texture.index]; }
+	//add a reference to a loaded texture, for handing one handle to many users
+	void addTextureRef(AssetHandle texture)
+	{ registry.addRef(texture); }
+	//drop a reference, the texture is deleted with the last one
+	void releaseTexture(AssetHandle texture);
+	//get the array and layer to sample, array 0 if the handle isn't loaded
+	TextureSlice getSlice(AssetHandle texture)
+	{
+		TextureSlice none = { 0, 0 };
+		return registry.isLive(texture) ? slices[texture.index] : none;
+	}
 };
 
 #endif
\ No newline at end of file
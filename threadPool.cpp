@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "threadPool.h"
+
+//Chunks of one parallelFor, shared with the workers since late ones may run after it returns
+struct ParallelRange
+{
+	std::function<void(unsigned int, unsigned int)> job;
+	unsigned int count;
+	unsigned int grain;
+	unsigned int chunks;
+	std::atomic<unsigned int> next; //next chunk to claim
+	std::atomic<unsigned int> done; //chunks finished
+};
+
+//claim and run chunks until none are left
+static void runChunks(ParallelRange &range)
+{
+	while (1)
+	{
+		unsigned int chunk = range.next++;
+		if (chunk >= range.chunks)
+			return;
+		unsigned int first = chunk * range.grain;
+		range.job(first, std::min(range.grain, range.count - first));
+		range.done++;
+	}
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	stopping = 0;
+	if (threadCount == 0)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		threadCount = cores > 1 ? cores - 1 : 1;
+	}
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopping = 1;
+	}
+	jobAdded.notify_all();
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers.at(i).join();
+}
+
+void ThreadPool::addJob(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs.push(job);
+	}
+	jobAdded.notify_one();
+}
+
+void ThreadPool::parallelFor(unsigned int count, unsigned int grain, std::function<void(unsigned int, unsigned int)> job)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+	unsigned int chunks = (count + grain - 1) / grain;
+	if (chunks == 1 || workers.empty())
+	{
+		job(0, count);
+		return;
+	}
+
+	std::shared_ptr<ParallelRange> range = std::make_shared<ParallelRange>();
+	range->job = job;
+	range->count = count;
+	range->grain = grain;
+	range->chunks = chunks;
+	range->next = 0;
+	range->done = 0;
+	unsigned int helpers = std::min(chunks - 1, getThreadCount());
+	for (unsigned int i = 0; i < helpers; i++)
+		addJob([range]() { runChunks(*range); });
+
+	runChunks(*range);
+	//only chunks a worker already claimed are left, they're short
+	while (range->done < chunks)
+		std::this_thread::yield();
+}
+
+void ThreadPool::workerLoop()
+{
+	while (1)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			while (jobs.empty() && !stopping)
+				jobAdded.wait(lock);
+			//only quit once the queue is drained so no job is lost
+			if (jobs.empty())
+				return;
+			job = jobs.front();
+			jobs.pop();
+		}
+		job();
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef Z_THREADPOOL
+#define Z_THREADPOOL
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//Fixed set of worker threads that run jobs in the order they were added
+class ThreadPool
+{
+	std::vector<std::thread> workers; //the threads
+	std::queue<std::function<void()> > jobs; //jobs not picked up yet
+	std::mutex jobMutex; //guards jobs and stopping
+	std::condition_variable jobAdded; //wakes a worker when there is a job
+	bool stopping; //set when the pool is shutting down
+
+	//loop each worker runs
+	void workerLoop();
+
+	//no copying, the threads belong to one pool
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+public:
+	//0 threads means one per core, leaving one for the main thread
+	ThreadPool(unsigned int threadCount = 0);
+	//finishes every queued job, then joins the threads
+	~ThreadPool();
+
+	//queue a job to run on a worker
+	void addJob(std::function<void()> job);
+	//run job over [0, count) in chunks of grain items, job gets the first item and how many
+	//the calling thread works on chunks too and returns once all are done, so it never waits
+	//behind long jobs already queued, workers that get to it late find nothing left
+	void parallelFor(unsigned int count, unsigned int grain, std::function<void(unsigned int, unsigned int)> job);
+	//number of worker threads
+	unsigned int getThreadCount() const
+	{ return workers.size(); }
+};
+
+#endif
@@ -1,9 +1,9 @@
 #version 330 core
 
 // Input vertex data, different for all executions of this shader.
-layout(location = 0) in vec3 vertexPosition_modelspace;
-layout(location = 1) in vec2 vertexUV;
-layout(location = 2) in vec3 vertexNormal_modelspace;
+layout(location = 0) in vec3 vertexPosition_quantized; // 16 bit, normalized to the model's bounds
+layout(location = 1) in vec2 vertexUV; // half float
+layout(location = 2) in vec2 vertexNormal_octahedral; // octahedral encoded, signed normalized
 
 // Output data ; will be interpolated for each fragment.
 out vec2 UV;
@@ -19,9 +19,22 @@ uniform mat4 V;
 uniform mat4 M;
 uniform vec3 LightInvDirection_worldspace;
 uniform mat4 DepthBiasMVP;
+uniform vec3 PositionDequant[2]; // offset, scale of the model's bounds
+
+// Unfold an octahedral encoded normal back onto the sphere
+vec3 decodeOctahedral(vec2 e){
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
 
 void main(){
 
+	vec3 vertexPosition_modelspace = PositionDequant[0] + PositionDequant[1] * vertexPosition_quantized;
+	vec3 vertexNormal_modelspace = decodeOctahedral(vertexNormal_octahedral);
+
 	// Output position of the vertex, in clip space : MVP * position
 	gl_Position =  MVP * vec4(vertexPosition_modelspace,1);
 	
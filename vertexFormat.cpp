@@ -0,0 +1,107 @@
+#include <math.h>
+#include <string.h>
+
+#include "vertexFormat.h"
+
+PositionDequant getPositionDequant(glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	PositionDequant dequant;
+	dequant.offset = boundsMin;
+	dequant.scale = boundsMax - boundsMin;
+	//flat models still need a non zero range to divide by
+	for (int i = 0; i < 3; i++)
+	{
+		if (dequant.scale[i] <= 0.0f)
+			dequant.scale[i] = 1.0f;
+	}
+	return dequant;
+}
+
+//map [0, 1] to a normalized 16 bit value
+static GLushort unorm16(float v)
+{
+	return (GLushort)floorf(glm::clamp(v, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+//map [-1, 1] to a signed normalized 16 bit value
+static GLshort snorm16(float v)
+{
+	float scaled = glm::clamp(v, -1.0f, 1.0f) * 32767.0f;
+	return (GLshort)(scaled >= 0.0f ? floorf(scaled + 0.5f) : ceilf(scaled - 0.5f));
+}
+
+PackedPosition packPosition(glm::vec3 pos, const PositionDequant &dequant)
+{
+	PackedPosition packed;
+	for (int i = 0; i < 3; i++)
+		packed.pos[i] = unorm16((pos[i] - dequant.offset[i]) / dequant.scale[i]);
+	packed.pos[3] = 0;
+	return packed;
+}
+
+PackedAttributes packAttributes(const VertexAttributes &attrib)
+{
+	PackedAttributes packed;
+	packed.uv[0] = floatToHalf(attrib.uv.x);
+	packed.uv[1] = floatToHalf(attrib.uv.y);
+	glm::vec2 oct = octahedralEncode(attrib.normal);
+	packed.normal[0] = snorm16(oct.x);
+	packed.normal[1] = snorm16(oct.y);
+	return packed;
+}
+
+GLhalf floatToHalf(float f)
+{
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	unsigned int mantissa = bits & 0x7fffff;
+
+	//NaN and infinity
+	if (((bits >> 23) & 0xff) == 0xff)
+		return (GLhalf)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	//too big, clamp to infinity
+	if (exponent >= 31)
+		return (GLhalf)(sign | 0x7c00);
+	//too small even for a denormal
+	if (exponent < -10)
+		return (GLhalf)sign;
+	//denormal, shift the implicit 1 in
+	if (exponent <= 0)
+	{
+		mantissa |= 0x800000;
+		unsigned int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		unsigned int rest = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		return (GLhalf)(sign | half);
+	}
+
+	//normal, round to nearest even (a carry into the exponent is still correct)
+	unsigned int half = ((unsigned int)exponent << 10) | (mantissa >> 13);
+	unsigned int rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return (GLhalf)(sign | half);
+}
+
+glm::vec2 octahedralEncode(glm::vec3 n)
+{
+	float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (sum <= 0.0f)
+		return glm::vec2(0.0f, 0.0f);
+	n /= sum;
+
+	//fold the lower hemisphere over the diagonals
+	if (n.z < 0.0f)
+	{
+		float x = (1.0f - fabsf(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		float y = (1.0f - fabsf(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		return glm::vec2(x, y);
+	}
+	return glm::vec2(n.x, n.y);
+}
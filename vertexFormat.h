@@ -0,0 +1,50 @@
+#ifndef Z_VERTFORMAT
+#define Z_VERTFORMAT
+
+//Include GLEW. Always include it before gl.h and glfw.h, since it's a bit magic.
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+//Everything but the position of a vertex, full precision, used while importing
+struct VertexAttributes
+{
+	glm::vec2 uv;
+	glm::vec3 normal;
+};
+
+//Position stored as 16 bit unsigned normalized against the model's AABB
+//the 4th component is padding to keep vertices 8 byte aligned
+struct PackedPosition
+{
+	GLushort pos[4];
+};
+
+//Interleaved uv/normal stream, 8 bytes instead of 20
+struct PackedAttributes
+{
+	GLhalf uv[2]; //half float uv
+	GLshort normal[2]; //octahedral encoded normal, signed normalized
+};
+
+//Scale and offset that turn a PackedPosition back into model space, uploaded as a vec3[2]
+struct PositionDequant
+{
+	glm::vec3 offset; //model space position of (0,0,0)
+	glm::vec3 scale; //model space size of the quantization range
+};
+
+//Get the dequantization range for an AABB
+PositionDequant getPositionDequant(glm::vec3 boundsMin, glm::vec3 boundsMax);
+
+//Quantize a position into the range
+PackedPosition packPosition(glm::vec3 pos, const PositionDequant &dequant);
+//Pack uv and normal
+PackedAttributes packAttributes(const VertexAttributes &attrib);
+
+//Float to half float, rounded to nearest
+GLhalf floatToHalf(float f);
+//Unit vector to octahedral coordinates in [-1, 1]
+glm::vec2 octahedralEncode(glm::vec3 n);
+
+#endif